@@ -0,0 +1,139 @@
+/*
+ * module-murphy-ivi -- PulseAudio module for providing audio routing support
+ * Copyright (c) 2012, Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St - Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ *
+ */
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <pulsecore/pulsecore-config.h>
+
+#include <pulse/xmalloc.h>
+#include <pulsecore/idxset.h>
+#include <pulsecore/hashmap.h>
+#include <pulsecore/log.h>
+
+#include "atom.h"
+
+typedef struct {
+    uint32_t  refcnt;
+    char      str[];
+} pa_atom;
+
+struct pa_atomset {
+    pa_hashmap  *atoms;  /**< pa_atom's by their string */
+    uint32_t     nalloc; /**< atoms created since startup */
+    uint32_t     nreuse; /**< requests satisfied by an existing atom */
+};
+
+#define ATOM(s)  ((pa_atom *)((char *)(s) - offsetof(pa_atom, str)))
+
+
+pa_atomset *pa_atomset_init(struct userdata *u)
+{
+    pa_atomset *as;
+
+    pa_assert(u);
+
+    as = pa_xnew0(pa_atomset, 1);
+    as->atoms = pa_hashmap_new(pa_idxset_string_hash_func,
+                               pa_idxset_string_compare_func);
+
+    return as;
+}
+
+void pa_atomset_done(struct userdata *u)
+{
+    pa_atomset *as;
+    pa_atom    *atom;
+    void       *state;
+
+    if (u && (as = u->atoms)) {
+        pa_log_debug("atoms: %u created, %u reused, %u alive",
+                     as->nalloc, as->nreuse, pa_hashmap_size(as->atoms));
+
+        PA_HASHMAP_FOREACH(atom, as->atoms, state) {
+            pa_xfree(atom);
+        }
+
+        pa_hashmap_free(as->atoms);
+        pa_xfree(as);
+
+        u->atoms = NULL;
+    }
+}
+
+const char *pa_atom_get(struct userdata *u, const char *str)
+{
+    pa_atomset *as;
+    pa_atom    *atom;
+    size_t      len;
+
+    pa_assert(u);
+    pa_assert_se((as = u->atoms));
+
+    if (!str)
+        return NULL;
+
+    if ((atom = pa_hashmap_get(as->atoms, str))) {
+        atom->refcnt++;
+        as->nreuse++;
+    }
+    else {
+        len = strlen(str);
+
+        atom = pa_xmalloc(sizeof(pa_atom) + len + 1);
+        atom->refcnt = 1;
+        memcpy(atom->str, str, len + 1);
+
+        pa_hashmap_put(as->atoms, atom->str, atom);
+
+        as->nalloc++;
+    }
+
+    return atom->str;
+}
+
+void pa_atom_unref(struct userdata *u, const char *str)
+{
+    pa_atomset *as;
+    pa_atom    *atom;
+
+    pa_assert(u);
+    pa_assert_se((as = u->atoms));
+
+    if (str) {
+        atom = ATOM(str);
+
+        pa_assert(atom->refcnt > 0);
+
+        if (!--atom->refcnt) {
+            pa_assert_se(pa_hashmap_remove(as->atoms, atom->str) == atom);
+            pa_xfree(atom);
+        }
+    }
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
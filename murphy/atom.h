@@ -0,0 +1,48 @@
+/*
+ * module-murphy-ivi -- PulseAudio module for providing audio routing support
+ * Copyright (c) 2012, Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St - Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ *
+ */
+#ifndef foomiratomfoo
+#define foomiratomfoo
+
+#include <sys/types.h>
+
+#include "userdata.h"
+
+/*
+ * atoms are interned, reference counted, read-only strings. Equal
+ * strings are interned to the same atom, so atoms can be compared
+ * by their address.
+ */
+
+pa_atomset *pa_atomset_init(struct userdata *);
+void pa_atomset_done(struct userdata *);
+
+const char *pa_atom_get(struct userdata *, const char *);
+void pa_atom_unref(struct userdata *, const char *);
+
+#endif  /* foomiratomfoo */
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
@@ -34,18 +34,13 @@ ot, write to the
 #include <pulsecore/device-port.h>
 #include <pulsecore/core-util.h>
 
-#ifdef WITH_AUL
-#include <aul.h>
-#include <bundle.h>
-#endif
-
 #include "classify.h"
 #include "node.h"
 #include "utils.h"
+#include "pidcache.h"
 
+static int pid2exe(struct userdata *, pid_t, bool, char *, size_t);
 
-static int pid2exe(pid_t, char *, size_t);
-static char *pid2appid(pid_t, char *, size_t);
 
 void pa_classify_node_by_card(mir_node        *node,
                               pa_card         *card,
@@ -295,13 +290,14 @@ void pa_classify_guess_device_node_type_and_name(mir_node   *node,
 
 mir_node_type pa_classify_guess_stream_node_type(struct userdata *u,
                                                  pa_proplist *pl,
-                                                 pa_nodeset_resdef **resdef)
+                                                 pa_nodeset_resdef **resdef,
+                                                 bool async)
 {
     pa_nodeset_map *map = NULL;
     const char     *role;
     const char     *bin;
     char            buf[4096];
-    char            appid[PATH_MAX];
+    const char     *appid;
     const char     *pidstr;
     const char     *name;
     int             pid;
@@ -318,28 +314,26 @@ mir_node_type pa_classify_guess_stream_node_type(struct userdata *u,
         }
 
         if ((bin = pa_proplist_gets(pl, PA_PROP_APPLICATION_PROCESS_BINARY))) {
-            if (!strcmp(bin, "threaded-ml") ||
-                !strcmp(bin, "WebProcess")  ||
-                !strcmp(bin,"wrt_launchpad_daemon"))
-            {
+            map = pa_nodeset_get_map_by_binary(u, bin);
+
+            if (map && (map->flags & PA_NODESET_MAP_LAUNCHER)) {
+                map = NULL;
+
                 if (!pid)
                     break;
 
-#ifdef WITH_AUL
-                if (aul_app_get_appid_bypid(pid, buf, sizeof(buf)) < 0 &&
-                    pid2exe(pid, buf, sizeof(buf)) < 0)
-                {
-                    pa_log("can't obtain real application name for wrt '%s' "
-                           "(pid %d)", bin, pid);
-                    break;
-                }
-#else
-                if (pid2exe(pid, buf, sizeof(buf)) < 0) {
-                    pa_log("can't obtain real application name for wrt '%s' "
-                           "(pid %d)", bin, pid);
+                /* AUL is consulted by the pidcache, if available */
+                if (pid2exe(u, pid, async, buf, sizeof(buf)) < 0) {
+                    if (pa_pidcache_is_pending(u, pid)) {
+                        pa_log_debug("real application name for wrt '%s' "
+                                     "(pid %d) is being looked up", bin, pid);
+                    }
+                    else {
+                        pa_log("can't obtain real application name for wrt "
+                               "'%s' (pid %d)", bin, pid);
+                    }
                     break;
                 }
-#endif
                 if ((name = strrchr(buf, '.')))
                     name++;
                 else
@@ -349,9 +343,13 @@ mir_node_type pa_classify_guess_stream_node_type(struct userdata *u,
                 pa_proplist_sets(pl, PA_PROP_APPLICATION_PROCESS_BINARY, buf);
 
                 bin = buf;
+                map = pa_nodeset_get_map_by_binary(u, bin);
+
+                if (map && (map->flags & PA_NODESET_MAP_LAUNCHER))
+                    map = NULL;
             }
 
-            if ((map = pa_nodeset_get_map_by_binary(u, bin))) {
+            if (map) {
                 if (map->role)
                     pa_proplist_sets(pl, PA_PROP_MEDIA_ROLE, map->role);
                 break;
@@ -369,7 +367,7 @@ mir_node_type pa_classify_guess_stream_node_type(struct userdata *u,
 
     } while (0);
 
-    if (pid2appid(pid, appid, sizeof(appid)))
+    if ((appid = pa_pidcache_get_appid(u, pid, async)))
         pa_proplist_sets(pl, PA_PROP_RESOURCE_SET_APPID, appid);
 
     if (resdef)
@@ -378,207 +376,20 @@ mir_node_type pa_classify_guess_stream_node_type(struct userdata *u,
     return map ? map->type : mir_player;
 }
 
-static char *get_tag(pid_t pid, const char *tag, char *buf, size_t size)
-{
-    char path[PATH_MAX];
-    char data[8192], *p, *q;
-    int  fd, n;
-    size_t tlen;
-
-    fd = -1;
-    snprintf(path, sizeof(path), "/proc/%u/status", pid);
-
-    if ((fd = open(path, O_RDONLY)) < 0) {
-    fail:
-        if (fd >= 0)
-            close(fd);
-        return NULL;
-    }
-
-    if ((n = read(fd, data, sizeof(data) - 1)) <= 0)
-        goto fail;
-    else
-        data[sizeof(data)-1] = '\0';
-
-    close(fd);
-    fd = -1;
-    tlen = strlen(tag);
-
-    p = data;
-    while (*p) {
-        if (*p != '\n' && p != data) {
-            while (*p && *p != '\n')
-                p++;
-        }
-
-        if (*p == '\n')
-            p++;
-        else
-            if (p != data)
-                goto fail;
-
-        if (!strncmp(p, tag, tlen) && p[tlen] == ':') {
-            p += tlen + 1;
-            while (*p == ' ' || *p == '\t')
-                p++;
-
-            q = buf;
-            while (*p != '\n' && *p && size > 1)
-                *q++ = *p++;
-            *q = '\0';
-
-            return buf;
-        }
-        else
-            p++;
-    }
-
-    goto fail;
-}
-
-
-static pid_t get_ppid(pid_t pid)
+static int pid2exe(struct userdata *u, pid_t pid, bool async,
+                   char *buf, size_t len)
 {
-    char  buf[32], *end;
-    pid_t ppid;
+    const char *exe;
 
-    if (get_tag(pid, "PPid", buf, sizeof(buf)) != NULL) {
-        ppid = strtol(buf, &end, 10);
+    if (!(exe = pa_pidcache_get_exe(u, pid, async)))
+        return -1;
 
-        if (end && !*end)
-            return ppid;
-    }
+    pa_strlcpy(buf, exe, len);
 
     return 0;
 }
 
 
-static int pid2exe(pid_t pid, char *buf, size_t len)
-{
-    pid_t ppid;
-    FILE *f;
-    char path[PATH_MAX];
-    char *p, *q;
-    int st = -1;
-
-    if (buf && len > 0) {
-        ppid = get_ppid(pid);
-
-        snprintf(path, sizeof(path), "/proc/%u/cmdline", ppid);
-
-        if ((f = fopen(path, "r"))) {
-            if (fgets(buf, (int)len-1, f)) {
-                if ((p = strchr(buf, ' ')))
-                    *p = '\0';
-                else if ((p = strchr(buf, '\n')))
-                    *p = '\0';
-                else
-                    p = buf + strlen(buf);
-
-                if ((q = strrchr(buf, '/')))
-                    memmove(buf, q+1, (size_t)(p-q)); 
-
-                st = 0;
-            }
-            fclose(f);
-        }
-    }
-
-    if (st < 0)
-        pa_log("pid2exe(%u) failed", pid);
-    else
-        pa_log_debug("pid2exe(%u) => exe %s", pid, buf);
-
-    return st;
-}
-
-
-static char *get_binary(pid_t pid, char *buf, size_t size)
-{
-    char    path[128];
-    ssize_t len;
-
-    snprintf(path, sizeof(path), "/proc/%u/exe", pid);
-    if ((len = readlink(path, buf, size - 1)) > 0) {
-        buf[len] = '\0';
-        return buf;
-    }
-    else
-        return NULL;
-}
-
-
-static char *strprev(char *point, char c, char *base)
-{
-    while (point > base && *point != c)
-        point--;
-
-    if (*point == c)
-        return point;
-    else
-        return NULL;
-}
-
-
-static char *pid2appid(pid_t pid, char *buf, size_t size)
-{
-    char binary[PATH_MAX];
-    char path[PATH_MAX], *dir, *p, *base;
-    unsigned int len;
-
-    if (!pid || !get_binary(pid, binary, sizeof(binary)))
-        return NULL;
-
-    strncpy(path, binary, sizeof(path) - 1);
-    path[sizeof(path) - 1] = '\0';
-
-    /* fetch basename */
-    if ((p = strrchr(path, '/')) == NULL || p == path) {
-        strncpy(buf, binary, size - 1);
-        buf[size - 1] = '\0';
-        return buf;
-    }
-
-    base = p-- + 1;
-
-    /* fetch ../bin/<basename> */
-    if ((p = strprev(p, '/', path)) == NULL || p == path)
-        goto return_base;
-
-    if (strncmp(p + 1, "bin/", 4) != 0)
-        goto return_base;
-    else
-        p--;
-
-    /* fetch dir name above bin */
-    if ((dir = strprev(p, '/', path)) == NULL || dir == path)
-        goto return_base;
-
-    len = (size_t)(p - dir);
-
-    /* fetch 'apps' dir */
-    p = dir - 1;
-
-    if ((p = strprev(p, '/', path)) == NULL)
-        goto return_base;
-
-    if (strncmp(p + 1, "apps/", 5) != 0)
-        goto return_base;
-
-    if (len + 1 <= size) {
-        strncpy(buf, dir + 1, len);
-        buf[len] = '\0';
-
-        return buf;
-    }
-
- return_base:
-    strncpy(buf, base, size - 1);
-    buf[size - 1] = '\0';
-    return buf;
-}
-
-
 mir_node_type pa_classify_guess_application_class(mir_node *node)
 {
     mir_node_type class;
@@ -31,7 +31,7 @@ void pa_classify_guess_device_node_type_and_name(mir_node*, const char *,
                                                  const char *);
 mir_node_type pa_classify_guess_stream_node_type(struct userdata *,
                                                  pa_proplist *,
-                                                 pa_nodeset_resdef **);
+                                                 pa_nodeset_resdef **, bool);
 mir_node_type pa_classify_guess_application_class(mir_node *);
 
 bool pa_classify_multiplex_stream(mir_node *);
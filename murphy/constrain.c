@@ -31,6 +31,7 @@
 #include "constrain.h"
 #include "router.h"
 #include "node.h"
+#include "slab.h"
 
 
 static mir_constr_def *cstrdef_create(struct userdata *, const char *,
@@ -41,6 +42,10 @@ static mir_constr_link *cstrlink_create(struct userdata *, mir_constr_def *,
                                         mir_node *);
 static void cstrlink_destroy(struct userdata *, mir_constr_link *);
 
+static void slot_alloc(pa_constrain *, mir_node *);
+static void slot_free(pa_constrain *, mir_node *);
+static void start_pass(pa_constrain *, uint32_t);
+
 pa_constrain *pa_constrain_init(struct userdata *u)
 {
     pa_constrain *constrain = pa_xnew0(pa_constrain, 1);
@@ -63,6 +68,10 @@ void pa_constrain_done(struct userdata *u)
 
         pa_hashmap_free(constrain->defs);
 
+        pa_xfree(constrain->used);
+        pa_xfree(constrain->applied);
+        pa_xfree(constrain->blocked);
+
         pa_xfree(constrain);
 
         u->constrain = NULL;
@@ -147,6 +156,9 @@ void mir_constrain_add_node(struct userdata *u,
     pa_assert(node);
 
     if (cd) {
+        if (node->cstrslot == PA_IDXSET_INVALID)
+            slot_alloc(u->constrain, node);
+
         cl = cstrlink_create(u, cd, node);
 
         MIR_DLIST_APPEND(mir_constr_link, link, cl, &cd->nodes);
@@ -178,16 +190,20 @@ void mir_constrain_remove_node(struct userdata *u, mir_node *node)
 
 void mir_constrain_apply(struct userdata *u, mir_node *node, uint32_t stamp)
 {
+    pa_constrain    *constrain;
     mir_constr_link *cl;
     mir_constr_def  *cd;
     mir_constr_link *c;
     mir_node        *n;
-    mir_rtentry     *rte;
-    mir_rtgroup     *rtg;
-    bool        blocked;
+    uint32_t         slot;
+    uint32_t         bit;
+    bool             blocked;
 
     pa_assert(u);
     pa_assert(node);
+    pa_assert_se((constrain = u->constrain));
+
+    start_pass(constrain, stamp);
 
     MIR_DLIST_FOR_EACH(mir_constr_link, nodchain, cl, &node->constrains) {
         pa_assert(node == cl->node);
@@ -199,18 +215,51 @@ void mir_constrain_apply(struct userdata *u, mir_node *node, uint32_t stamp)
             n = c->node;
             blocked = cd->func(u, cd, node, n);
 
-            MIR_DLIST_FOR_EACH(mir_rtentry, nodchain, rte, &n->rtentries) {
-                pa_assert_se((rtg = rte->group));
+            pa_assert_se((slot = n->cstrslot) != PA_IDXSET_INVALID);
+
+            bit = ((uint32_t)1) << (slot & 31);
 
-                rte->blocked = blocked;
-                rte->stamp   = stamp;
+            constrain->applied[slot >> 5] |= bit;
 
-                pa_log_debug("   %sblocking '%s' in table '%s'",
-                             blocked ? "":"un", n->amname, rtg->name);
-            }
+            if (blocked)
+                constrain->blocked[slot >> 5] |= bit;
+            else
+                constrain->blocked[slot >> 5] &= ~bit;
+
+            pa_log_debug("   %sblocking '%s'", blocked ? "":"un", n->amname);
         }
     }
-} 
+}
+
+bool mir_constrain_applied(struct userdata *u, mir_node *node, uint32_t stamp)
+{
+    pa_constrain *constrain;
+    uint32_t      slot;
+
+    pa_assert(u);
+    pa_assert(node);
+    pa_assert_se((constrain = u->constrain));
+
+    if ((slot = node->cstrslot) == PA_IDXSET_INVALID || stamp != constrain->stamp)
+        return false;
+
+    return (constrain->applied[slot >> 5] >> (slot & 31)) & 1;
+}
+
+bool mir_constrain_blocked(struct userdata *u, mir_node *node, uint32_t stamp)
+{
+    pa_constrain *constrain;
+    uint32_t      slot;
+
+    pa_assert(u);
+    pa_assert(node);
+    pa_assert_se((constrain = u->constrain));
+
+    if ((slot = node->cstrslot) == PA_IDXSET_INVALID || stamp != constrain->stamp)
+        return false;
+
+    return (constrain->blocked[slot >> 5] >> (slot & 31)) & 1;
+}
 
 int mir_constrain_print(mir_node *node, char *buf, int len)
 {
@@ -268,8 +317,8 @@ bool mir_constrain_profile(struct userdata *u,
                                 mir_node        *active,
                                 mir_node        *node)
 {
-    char *active_profile;
-    char *node_profile;
+    const char *active_profile;
+    const char *node_profile;
     bool block;
 
     pa_assert(u);
@@ -332,7 +381,7 @@ static mir_constr_link *cstrlink_create(struct userdata *u,
     pa_assert(cd);
     pa_assert(node);
 
-    cl = pa_xnew0(mir_constr_link, 1);
+    cl = pa_slab_alloc(u, PA_SLAB_CONSTR_LINK);
     cl->def  = cd;
     cl->node = node;
     MIR_DLIST_INIT(cl->link);
@@ -343,13 +392,93 @@ static mir_constr_link *cstrlink_create(struct userdata *u,
 
 static void cstrlink_destroy(struct userdata *u, mir_constr_link *cl)
 {
+    mir_node *node;
+
     pa_assert(u);
     pa_assert(cl);
+    pa_assert_se((node = cl->node));
 
     MIR_DLIST_UNLINK(mir_constr_link, link, cl);
     MIR_DLIST_UNLINK(mir_constr_link, nodchain, cl);
 
-    pa_xfree(cl);
+    if (MIR_DLIST_EMPTY(node->constrains))
+        slot_free(u->constrain, node);
+
+    pa_slab_free(u, PA_SLAB_CONSTR_LINK, cl);
+}
+
+
+static void slot_alloc(pa_constrain *constrain, mir_node *node)
+{
+    size_t   i;
+    size_t   size;
+    uint32_t avail;
+    uint32_t slot;
+
+    pa_assert(constrain);
+    pa_assert(node);
+
+    for (i = 0;  i < constrain->nword;  i++) {
+        if ((avail = ~constrain->used[i]))
+            break;
+    }
+
+    if (i == constrain->nword) {
+        constrain->nword += 2;
+        size = sizeof(uint32_t) * constrain->nword;
+
+        constrain->used    = pa_xrealloc(constrain->used   , size);
+        constrain->applied = pa_xrealloc(constrain->applied, size);
+        constrain->blocked = pa_xrealloc(constrain->blocked, size);
+
+        memset(constrain->used    + i, 0, sizeof(uint32_t) * 2);
+        memset(constrain->applied + i, 0, sizeof(uint32_t) * 2);
+        memset(constrain->blocked + i, 0, sizeof(uint32_t) * 2);
+
+        avail = ~((uint32_t)0);
+    }
+
+    for (slot = 0;  !(avail & (((uint32_t)1) << slot));  slot++)
+        ;
+
+    constrain->used[i] |= ((uint32_t)1) << slot;
+
+    node->cstrslot = (uint32_t)(i * 32) + slot;
+}
+
+static void slot_free(pa_constrain *constrain, mir_node *node)
+{
+    uint32_t slot;
+    uint32_t bit;
+
+    pa_assert(constrain);
+    pa_assert(node);
+
+    if ((slot = node->cstrslot) != PA_IDXSET_INVALID) {
+        bit = ((uint32_t)1) << (slot & 31);
+
+        constrain->used[slot >> 5]    &= ~bit;
+        constrain->applied[slot >> 5] &= ~bit;
+        constrain->blocked[slot >> 5] &= ~bit;
+
+        node->cstrslot = PA_IDXSET_INVALID;
+    }
+}
+
+static void start_pass(pa_constrain *constrain, uint32_t stamp)
+{
+    size_t size;
+
+    pa_assert(constrain);
+
+    if (stamp != constrain->stamp) {
+        size = sizeof(uint32_t) * constrain->nword;
+
+        memset(constrain->applied, 0, size);
+        memset(constrain->blocked, 0, size);
+
+        constrain->stamp = stamp;
+    }
 }
 
 
@@ -28,8 +28,17 @@
 typedef bool (*mir_constrain_func_t)(struct userdata *, mir_constr_def *,
                                           mir_node *, mir_node *);
 
+/*
+ * constrained nodes get a slot; the per routing pass state of the
+ * nodes is kept in bitmaps indexed by the slots
+ */
 struct pa_constrain {
     pa_hashmap *defs;
+    size_t      nword;    /**< length of the bitmaps in 32-bit words */
+    uint32_t   *used;     /**< allocated slots */
+    uint32_t   *applied;  /**< blocking decided in the current pass */
+    uint32_t   *blocked;  /**< blocked in the current pass */
+    uint32_t    stamp;    /**< the routing pass of applied & blocked */
 };
 
 
@@ -62,6 +71,8 @@ void mir_constrain_add_node(struct userdata *, mir_constr_def *, mir_node *);
 void mir_constrain_remove_node(struct userdata *, mir_node *);
 
 void mir_constrain_apply(struct userdata *, mir_node *, uint32_t);
+bool mir_constrain_applied(struct userdata *, mir_node *, uint32_t);
+bool mir_constrain_blocked(struct userdata *, mir_node *, uint32_t);
 
 int mir_constrain_print(mir_node *, char *, int);
 
@@ -18,6 +18,7 @@
  *
  */
 #include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
 
 #include <pulsecore/pulsecore-config.h>
@@ -47,6 +48,9 @@
 #include "extapi.h"
 #include "stream-state.h"
 #include "murphyif.h"
+#include "scheduler.h"
+#include "atom.h"
+#include "pidcache.h"
 
 #define MAX_CARD_TARGET   4
 #define MAX_NAME_LENGTH   256
@@ -83,6 +87,13 @@ typedef struct {
     uint32_t index;
 } stream_uncork_t;
 
+typedef struct {
+    uint32_t   index;     /**< card index */
+    pa_idxset *sinks;
+    pa_idxset *sources;
+    pa_idxset *nodes;     /**< device nodes of the card */
+} card_devices;
+
 static const char combine_pattern[]   = "Simultaneous output on ";
 static const char loopback_outpatrn[] = "Loopback from ";
 static const char loopback_inpatrn[]  = "Loopback to ";
@@ -118,11 +129,25 @@ static pa_source *make_input_prerouting(struct userdata *, mir_node *,
                                         const char *, mir_node **);
 
 static mir_node_type get_stream_routing_class(pa_proplist *);
+static pid_t get_stream_pid(pa_proplist *);
+static void add_provisional_stream(struct userdata *, pa_sink_input *);
+static void finalize_stream_class(struct userdata *, pa_sink_input *);
+static void release_provisional_stream(struct userdata *, pa_sink_input *);
+static void fill_stream_meta(struct userdata *, pa_sink_input *,
+                             mir_stream_meta *);
+static bool stream_meta_is_valid(struct userdata *, mir_stream_meta *);
+static void free_stream_meta(mir_stream_meta *);
 static const char *get_stream_amname(mir_node_type, const char *, pa_proplist *);
 
 static void set_bluetooth_profile(struct userdata *, pa_card *, pa_direction_t);
 
 
+static card_devices *card_devices_get(pa_discover *, uint32_t, bool);
+static void card_devices_free(pa_discover *, card_devices *);
+static void card_index_add_node(pa_discover *, mir_node *);
+static void card_index_remove_node(pa_discover *, mir_node *);
+
+
 static void schedule_deferred_routing(struct userdata *);
 static void schedule_card_check(struct userdata *, pa_card *);
 static void schedule_source_cleanup(struct userdata *, mir_node *);
@@ -142,6 +167,10 @@ struct pa_discover *pa_discover_init(struct userdata *u)
                                             pa_idxset_string_compare_func);
     discover->nodes.byptr  = pa_hashmap_new(pa_idxset_trivial_hash_func,
                                             pa_idxset_trivial_compare_func);
+    discover->streams      = pa_hashmap_new(pa_idxset_trivial_hash_func,
+                                            pa_idxset_trivial_compare_func);
+    discover->cards        = pa_hashmap_new(pa_idxset_trivial_hash_func,
+                                            pa_idxset_trivial_compare_func);
     return discover;
 }
 
@@ -150,13 +179,22 @@ void pa_discover_done(struct userdata *u)
     pa_discover *discover;
     void *state;
     mir_node *node;
+    mir_stream_meta *meta;
+    card_devices *cd;
 
     if (u && (discover = u->discover)) {
         PA_HASHMAP_FOREACH(node, discover->nodes.byname, state) {
             mir_node_destroy(u, node);
         }
+        while ((meta = pa_hashmap_steal_first(discover->streams)))
+            free_stream_meta(meta);
+        while ((cd = pa_hashmap_first(discover->cards)))
+            card_devices_free(discover, cd);
+        pa_hashmap_free(discover->cards);
         pa_hashmap_free(discover->nodes.byname);
         pa_hashmap_free(discover->nodes.byptr);
+        pa_hashmap_free(discover->streams);
+        pa_xfree(discover->provisional.index);
         pa_xfree(discover);
         u->discover = NULL;
     }
@@ -215,10 +253,10 @@ void pa_discover_add_card(struct userdata *u, pa_card *card)
 
 void pa_discover_remove_card(struct userdata *u, pa_card *card)
 {
-    const char  *bus;
-    pa_discover *discover;
-    mir_node    *node;
-    void        *state;
+    const char   *bus;
+    pa_discover  *discover;
+    mir_node     *node;
+    card_devices *cd;
 
     pa_assert(u);
     pa_assert(card);
@@ -227,15 +265,16 @@ void pa_discover_remove_card(struct userdata *u, pa_card *card)
     if (!(bus = pa_utils_get_card_bus(card)))
         bus = "<unknown>";
 
-    PA_HASHMAP_FOREACH(node, discover->nodes.byname, state) {
-        if (node->implement == mir_device &&
-            node->pacard.index == card->index)
-        {
+    if ((cd = card_devices_get(discover, card->index, false))) {
+        /* destroy_node() takes the node out of cd->nodes */
+        while ((node = pa_idxset_first(cd->nodes, NULL))) {
             if (pa_streq(bus, "pci") || pa_streq(bus, "usb") || pa_streq(bus, "platform"))
                 mir_constrain_destroy(u, node->paname);
 
             destroy_node(u, node);
         }
+
+        card_devices_free(discover, cd);
     }
 
     if (pa_streq(bus, "bluetooth"))
@@ -256,8 +295,10 @@ void pa_discover_profile_changed(struct userdata *u, pa_card *card)
     bool	platform;
     uint32_t         stamp;
     mir_node        *node;
-    void            *state;
+    mir_node       **stale;
+    card_devices    *cd;
     uint32_t         index;
+    uint32_t         i, n;
     bool        need_routing;
 
     pa_assert(u);
@@ -310,15 +351,15 @@ void pa_discover_profile_changed(struct userdata *u, pa_card *card)
             /* switched off but not unloaded yet */
             need_routing = false;
 
-            PA_HASHMAP_FOREACH(node, discover->nodes.byname, state) {
-                if (node->implement == mir_device &&
-                    node->pacard.index == card->index)
-                {
+            if ((cd = card_devices_get(discover, card->index, false))) {
+                PA_IDXSET_FOREACH(node, cd->nodes, index) {
                     if (node->type != mir_bluetooth_a2dp &&
                         node->type != mir_bluetooth_sco)
                     {
                         if (node->available) {
                             node->available = false;
+                            mir_node_update_hot(u, node);
+                            mir_router_mark_node_dirty(u, node);
                             need_routing = true;
                         }
                     }
@@ -337,13 +378,20 @@ void pa_discover_profile_changed(struct userdata *u, pa_card *card)
 
         handle_alsa_card(u, card);
 
-        PA_HASHMAP_FOREACH(node, discover->nodes.byname, state) {
-            if (node->implement == mir_device &&
-                node->pacard.index == card->index &&
-                node->stamp < stamp)
-            {
-                destroy_node(u, node);
+        if ((cd = card_devices_get(discover, card->index, false))) {
+            /* collected first, as destroy_node() updates cd->nodes */
+            stale = pa_xnew(mir_node *, pa_idxset_size(cd->nodes) + 1);
+            n = 0;
+
+            PA_IDXSET_FOREACH(node, cd->nodes, index) {
+                if (node->stamp < stamp)
+                    stale[n++] = node;
             }
+
+            for (i = 0;  i < n;  i++)
+                destroy_node(u, stale[i]);
+
+            pa_xfree(stale);
         }
     }
 
@@ -353,9 +401,11 @@ void pa_discover_port_available_changed(struct userdata *u,
                                         pa_device_port  *port)
 {
     pa_core       *core;
+    pa_discover   *discover;
     pa_sink       *sink;
     pa_source     *source;
     mir_node      *node;
+    card_devices  *cd;
     uint32_t       idx;
     bool      available;
     const char    *state;
@@ -367,6 +417,7 @@ void pa_discover_port_available_changed(struct userdata *u,
     pa_assert(u);
     pa_assert(port);
     pa_assert_se((core = u->core));
+    pa_assert_se((discover = u->discover));
 
     switch (port->available) {
     case PA_AVAILABLE_NO:    state = "not available";  break;
@@ -398,8 +449,16 @@ void pa_discover_port_available_changed(struct userdata *u,
         default:                 /* do nothing */      return;
         }
 
+        /* only the devices of the port's card can have the port */
+        if (!port->card ||
+            !(cd = card_devices_get(discover, port->card->index, false)))
+        {
+            pa_log_debug("no devices for port '%s'", port->name);
+            return;
+        }
+
         if (port->direction == PA_DIRECTION_OUTPUT) {
-            PA_IDXSET_FOREACH(sink, core->sinks, idx) {
+            PA_IDXSET_FOREACH(sink, cd->sinks, idx) {
                 if (sink->ports) {
                     if (port == pa_hashmap_get(sink->ports, port->name)) {
                         pa_log_debug("   sink '%s'", sink->name);
@@ -413,7 +472,7 @@ void pa_discover_port_available_changed(struct userdata *u,
         }
 
         if (port->direction == PA_DIRECTION_INPUT) {
-            PA_IDXSET_FOREACH(source, core->sources, idx) {
+            PA_IDXSET_FOREACH(source, cd->sources, idx) {
                 if (source->ports) {
                     if (port == pa_hashmap_get(source->ports, port->name)) {
                         pa_log_debug("   source '%s'", source->name);
@@ -428,7 +487,7 @@ void pa_discover_port_available_changed(struct userdata *u,
     }
 
     if (route)
-        mir_router_make_routing(u);
+        pa_scheduler_request(u, PA_SCHEDULER_ROUTING);
 }
 
 void pa_discover_add_sink(struct userdata *u, pa_sink *sink, bool route)
@@ -473,6 +532,8 @@ void pa_discover_add_sink(struct userdata *u, pa_sink *sink, bool route)
                      node->paname, node->key);
         node->paidx = sink->index;
         node->available = true;
+        mir_node_update_hot(u, node);
+        mir_router_mark_node_dirty(u, node);
         pa_discover_add_node_to_ptr_hash(u, sink, node);
 
         if ((loopback_role = pa_classify_loopback_stream(node))) {
@@ -506,7 +567,7 @@ void pa_discover_add_sink(struct userdata *u, pa_sink *sink, bool route)
             type = node->type;
 
             if (type != mir_bluetooth_a2dp && type != mir_bluetooth_sco)
-                mir_router_make_routing(u);
+                pa_scheduler_request(u, PA_SCHEDULER_ROUTING);
             else {
                 if (!u->state.profile)
                     schedule_deferred_routing(u);
@@ -523,6 +584,7 @@ void pa_discover_add_sink(struct userdata *u, pa_sink *sink, bool route)
         data.channels  = sink->channel_map.channels;
         data.available = true;
         data.paidx     = sink->index;
+        data.pacard.index = PA_IDXSET_INVALID;
 
         /* XXX: This implements a rule that all tunnel sinks shall be treated
          * as speaker nodes. That's pretty crappy rule, and even if it was
@@ -606,6 +668,7 @@ void pa_discover_remove_sink(struct userdata *u, pa_sink *sink)
         pa_murphyif_destroy_resource_set(u, node);
         schedule_source_cleanup(u, node);
         node->paidx = PA_IDXSET_INVALID;
+        mir_router_mark_node_dirty(u, node);
         pa_hashmap_remove(discover->nodes.byptr, sink);
 
         type = node->type;
@@ -621,6 +684,8 @@ void pa_discover_remove_sink(struct userdata *u, pa_sink *sink)
         else {
             pa_log_info("currently we do not support statically loaded sinks");
         }
+
+        mir_node_update_hot(u, node);
     }
 }
 
@@ -666,6 +731,8 @@ void pa_discover_add_source(struct userdata *u, pa_source *source)
                      node->amname);
         node->paidx = source->index;
         node->available = true;
+        mir_node_update_hot(u, node);
+        mir_router_mark_node_dirty(u, node);
         pa_discover_add_node_to_ptr_hash(u, source, node);
         if ((loopback_role = pa_classify_loopback_stream(node))) {
             if (!(ns = pa_utils_get_null_sink(u))) {
@@ -697,7 +764,7 @@ void pa_discover_add_source(struct userdata *u, pa_source *source)
             else
                 node->rset.grant = 1;
 
-            pa_fader_apply_volume_limits(u, node->stamp);
+            pa_scheduler_request(u, PA_SCHEDULER_VOLUME);
         }
     }
     else {
@@ -707,6 +774,7 @@ void pa_discover_add_source(struct userdata *u, pa_source *source)
         data.implement = mir_device;
         data.channels  = source->channel_map.channels;
         data.available = true;
+        data.pacard.index = PA_IDXSET_INVALID;
 
         /* XXX: This implements a rule that all tunnel sources shall be treated
          * as microphone nodes. That's pretty crappy rule, and even if it was
@@ -785,6 +853,7 @@ void pa_discover_remove_source(struct userdata *u, pa_source *source)
         pa_murphyif_destroy_resource_set(u, node);
         schedule_source_cleanup(u, node);
         node->paidx = PA_IDXSET_INVALID;
+        mir_router_mark_node_dirty(u, node);
         pa_hashmap_remove(discover->nodes.byptr, source);
 
         type = node->type;
@@ -801,6 +870,8 @@ void pa_discover_remove_source(struct userdata *u, pa_source *source)
             pa_log_info("currently we do not support statically "
                         "loaded sources");
         }
+
+        mir_node_update_hot(u, node);
     }
 }
 
@@ -844,7 +915,7 @@ void pa_discover_register_sink_input(struct userdata *u, pa_sink_input *sinp)
 
     pa_log_debug("registering input stream '%s'", name);
 
-    if (!(type = pa_classify_guess_stream_node_type(u, pl, &resdef))) {
+    if (!(type = pa_classify_guess_stream_node_type(u, pl, &resdef, false))) {
         pa_log_debug("cant find stream class for '%s'. "
                      "Leaving it alone", name);
         return;
@@ -879,7 +950,15 @@ void pa_discover_register_sink_input(struct userdata *u, pa_sink_input *sinp)
      */
     /* this will set data.mux */
     role = pa_proplist_gets(sinp->proplist, PA_PROP_MEDIA_ROLE);
-    sink = make_output_prerouting(u, &data, &sinp->channel_map, role, &target);
+
+    if (pa_scheduler_in_bulk(u)) {
+        /* routed by the single routing pass at the end of the bulk load */
+        sink = NULL;
+        target = NULL;
+    }
+    else
+        sink = make_output_prerouting(u, &data, &sinp->channel_map, role,
+                                      &target);
 
     node = create_node(u, &data, NULL);
     pa_assert(node);
@@ -959,15 +1038,23 @@ bool pa_discover_preroute_sink_input(struct userdata *u,
 
             data->sink = NULL;
 
-            type = pa_classify_guess_stream_node_type(u, pl, NULL);
+            type = pa_classify_guess_stream_node_type(u, pl, NULL, false);
         }
         else {
             remap = pa_streq(mnam, "module-remap-sink");
-            type = pa_classify_guess_stream_node_type(u, pl, &resdef);
+            type = pa_classify_guess_stream_node_type(u, pl, &resdef, true);
 
             pa_utils_set_resource_properties(pl, resdef);
 
-            if (pa_stream_state_start_corked(u, data, resdef)) {
+            if (pa_pidcache_is_pending(u, get_stream_pid(pl))) {
+                /* the process identity is still being looked up; route
+                   with the provisional class and hold the stream until
+                   the final class is known */
+                pa_proplist_sets(pl, PA_PROP_ROUTING_PROVISIONAL, "1");
+                pa_stream_state_hold(u, data);
+                pa_log_debug("start corked with a provisional class");
+            }
+            else if (pa_stream_state_start_corked(u, data, resdef)) {
                 pa_log_debug("start corked");
             }
         }
@@ -1053,6 +1140,7 @@ void pa_discover_add_sink_input(struct userdata *u, pa_sink_input *sinp)
     pa_nodeset_resdef *resdef;
     pa_nodeset_resdef  rdbuf;
     char               idbuf[512];
+    bool               provisional;
 
     pa_assert(u);
     pa_assert(sinp);
@@ -1062,6 +1150,7 @@ void pa_discover_add_sink_input(struct userdata *u, pa_sink_input *sinp)
     pa_assert_se((pl = sinp->proplist));
 
     resdef = NULL;
+    provisional = false;
 
     if (!(media = pa_proplist_gets(sinp->proplist, PA_PROP_MEDIA_NAME)))
         media = "<unknown>";
@@ -1102,17 +1191,28 @@ void pa_discover_add_sink_input(struct userdata *u, pa_sink_input *sinp)
 
         pa_log_debug("dealing with new input stream '%s'", name);
 
+        provisional = pa_proplist_gets(pl, PA_PROP_ROUTING_PROVISIONAL) != NULL;
+
         if ((type = get_stream_routing_class(pl)))
             resdef = pa_utils_get_resource_properties(pl, &rdbuf);
         else {
-            if (!(type = pa_classify_guess_stream_node_type(u, pl, &resdef))) {
+            type = pa_classify_guess_stream_node_type(u, pl, &resdef, true);
+
+            if (!type) {
                 pa_log_debug("cant find stream class for '%s'. "
                              "Leaving it alone", name);
+                if (provisional)
+                    release_provisional_stream(u, sinp);
                 return;
             }
 
             pa_utils_set_stream_routing_properties(pl, type, NULL);
 
+            /* the process may still be being looked up; if so, settle the
+               class when it is resolved */
+            if (pa_pidcache_is_pending(u, get_stream_pid(pl)))
+                provisional = true;
+
             /* if needed, make some post-routing here */
         }
 
@@ -1146,12 +1246,14 @@ void pa_discover_add_sink_input(struct userdata *u, pa_sink_input *sinp)
         if (!created) {
             pa_log("%s: confused with stream. '%s' did exists",
                    __FILE__, node->amname);
+            if (provisional)
+                release_provisional_stream(u, sinp);
             return;
         }
 
         if (node->rset.id)
             pa_murphyif_add_node(u, node);
-        else {
+        else if (!provisional) {
             if (resdef)
                 pa_murphyif_create_resource_set(u, node, resdef);
             else
@@ -1190,8 +1292,16 @@ void pa_discover_add_sink_input(struct userdata *u, pa_sink_input *sinp)
         /* else pa_audiomgr_add/register_explicit_route() */
 
 
-        pa_fader_apply_volume_limits(u, pa_utils_get_stamp());
+        /* the new stream must not play unlimited until the next batch;
+           the batch takes care of the other dirty sinks */
+        pa_fader_apply_sink_volume_limits(u, s);
+        pa_scheduler_request(u, PA_SCHEDULER_VOLUME);
     }
+
+    pa_discover_get_stream_meta(u, sinp);
+
+    if (provisional)
+        add_provisional_stream(u, sinp);
 }
 
 
@@ -1235,8 +1345,11 @@ void pa_discover_remove_sink_input(struct userdata *u, pa_sink_input *sinp)
         destroy_node(u, node);
     }
 
+    pa_discover_invalidate_stream_meta(u, sinp);
+    pa_fader_mark_sink_dirty(u, sinp->sink, true);
+
     if (node || had_properties)
-        mir_router_make_routing(u);
+        pa_scheduler_request(u, PA_SCHEDULER_ROUTING);
 }
 
 
@@ -1276,7 +1389,7 @@ void pa_discover_register_source_output(struct userdata  *u,
 
     pa_log_debug("registering output stream '%s'", name);
 
-    if (!(type = pa_classify_guess_stream_node_type(u, pl, &resdef))) {
+    if (!(type = pa_classify_guess_stream_node_type(u, pl, &resdef, false))) {
         pa_log_debug("cant find stream class for '%s'. "
                      "Leaving it alone", name);
         return;
@@ -1312,7 +1425,14 @@ void pa_discover_register_source_output(struct userdata  *u,
      * possibly overwiriting the orginal app request :(
      */
     role   = pa_proplist_gets(sout->proplist, PA_PROP_MEDIA_ROLE);
-    source = make_input_prerouting(u, &data, role, &target);
+
+    if (pa_scheduler_in_bulk(u)) {
+        /* routed by the single routing pass at the end of the bulk load */
+        source = NULL;
+        target = NULL;
+    }
+    else
+        source = make_input_prerouting(u, &data, role, &target);
 
     node = create_node(u, &data, NULL);
     pa_assert(node);
@@ -1371,10 +1491,10 @@ bool pa_discover_preroute_source_output(struct userdata *u,
 
         data->source = NULL;
 
-        type = pa_classify_guess_stream_node_type(u, pl, NULL);
+        type = pa_classify_guess_stream_node_type(u, pl, NULL, false);
     }
     else {
-        type = pa_classify_guess_stream_node_type(u, pl, &resdef);
+        type = pa_classify_guess_stream_node_type(u, pl, &resdef, false);
 
         pa_utils_set_resource_properties(pl, resdef);
     }
@@ -1467,7 +1587,9 @@ void pa_discover_add_source_output(struct userdata *u, pa_source_output *sout)
         if ((type = get_stream_routing_class(pl)))
             resdef = pa_utils_get_resource_properties(pl, &rdbuf);
         else {
-            if (!(type = pa_classify_guess_stream_node_type(u, pl, &resdef))) {
+            type = pa_classify_guess_stream_node_type(u, pl, &resdef, false);
+
+            if (!type) {
                 pa_log_debug("cant find stream class for '%s'. "
                              "Leaving it alone", name);
                 return;
@@ -1569,11 +1691,40 @@ void pa_discover_remove_source_output(struct userdata  *u,
 
         destroy_node(u, node);
 
-        mir_router_make_routing(u);
+        pa_scheduler_request(u, PA_SCHEDULER_ROUTING);
     }
 }
 
 
+void pa_discover_process_resolved(struct userdata *u, pid_t pid)
+{
+    pa_core       *core;
+    pa_discover   *discover;
+    pa_sink_input *sinp;
+    size_t         i;
+
+    pa_assert(u);
+    pa_assert_se((core = u->core));
+
+    if (!(discover = u->discover))
+        return;
+
+    for (i = discover->provisional.nindex;  i > 0;  i--) {
+        sinp = pa_idxset_get_by_index(core->sink_inputs,
+                                      discover->provisional.index[i-1]);
+
+        if (sinp && get_stream_pid(sinp->proplist) != pid)
+            continue;
+
+        discover->provisional.nindex--;
+        discover->provisional.index[i-1] =
+            discover->provisional.index[discover->provisional.nindex];
+
+        if (sinp)
+            finalize_stream_class(u, sinp);
+    }
+}
+
 mir_node *pa_discover_find_node_by_key(struct userdata *u, const char *key)
 {
     pa_discover *discover;
@@ -1618,17 +1769,71 @@ void pa_discover_add_node_to_ptr_hash(struct userdata *u,
     pa_assert_se((discover = u->discover));
 
     pa_hashmap_put(discover->nodes.byptr, ptr, node);
+
+    if (node->direction == mir_input && node->implement == mir_stream)
+        pa_discover_invalidate_stream_meta(u, ptr);
 }
 
 mir_node *pa_discover_remove_node_from_ptr_hash(struct userdata *u, void *ptr)
 {
     pa_discover *discover;
+    mir_node    *node;
 
     pa_assert(u);
     pa_assert(ptr);
     pa_assert_se((discover = u->discover));
 
-    return pa_hashmap_remove(discover->nodes.byptr, ptr);
+    node = pa_hashmap_remove(discover->nodes.byptr, ptr);
+
+    if (node && node->direction == mir_input && node->implement == mir_stream)
+        pa_discover_invalidate_stream_meta(u, ptr);
+
+    return node;
+}
+
+mir_stream_meta *pa_discover_get_stream_meta(struct userdata *u,
+                                             pa_sink_input *sinp)
+{
+    pa_discover     *discover;
+    mir_stream_meta *meta;
+
+    pa_assert(u);
+    pa_assert(sinp);
+    pa_assert_se((discover = u->discover));
+
+    if ((meta = pa_hashmap_get(discover->streams, sinp))) {
+        if (stream_meta_is_valid(u, meta))
+            return meta;
+
+        pa_xfree(meta->rsetid);
+    }
+    else {
+        meta = pa_xnew0(mir_stream_meta, 1);
+        pa_hashmap_put(discover->streams, sinp, meta);
+    }
+
+    fill_stream_meta(u, sinp, meta);
+
+    return meta;
+}
+
+void pa_discover_invalidate_stream_meta(struct userdata *u,
+                                        pa_sink_input *sinp)
+{
+    pa_discover     *discover;
+    mir_stream_meta *meta;
+
+    pa_assert(u);
+    pa_assert_se((discover = u->discover));
+
+    if (sinp) {
+        if ((meta = pa_hashmap_remove(discover->streams, sinp)))
+            free_stream_meta(meta);
+    }
+    else {
+        while ((meta = pa_hashmap_steal_first(discover->streams)))
+            free_stream_meta(meta);
+    }
 }
 
 
@@ -2039,13 +2244,14 @@ static mir_node *create_node(struct userdata *u, mir_node *data,
     pa_assert(data->paname);
     pa_assert_se((discover = u->discover));
 
-    if ((node = pa_hashmap_get(discover->nodes.byname, data->key)))
+    if ((node = pa_discover_find_node_by_key(u, data->key)))
         created = false;
     else {
         created = true;
 
         node = mir_node_create(u, data);
         pa_hashmap_put(discover->nodes.byname, node->key, node);
+        card_index_add_node(discover, node);
 
         mir_node_print(node, buf, sizeof(buf));
         pa_log_debug("new node:\n%s", buf);
@@ -2069,6 +2275,8 @@ static void destroy_node(struct userdata *u, mir_node *node)
     pa_assert_se((discover = u->discover));
 
     if (node) {
+        card_index_remove_node(discover, node);
+
         removed = pa_hashmap_remove(discover->nodes.byname, node->key);
 
         if (node != removed) {
@@ -2117,6 +2325,9 @@ static bool update_node_availability(struct userdata *u,
     {
         node->available = available;
 
+        mir_node_update_hot(u, node);
+        mir_router_mark_node_dirty(u, node);
+
         if (available)
             pa_audiomgr_register_node(u, node);
         else
@@ -2401,6 +2612,193 @@ static mir_node_type get_stream_routing_class(pa_proplist *pl)
     return mir_node_type_unknown;
 }
 
+static pid_t get_stream_pid(pa_proplist *pl)
+{
+    const char *pidstr;
+    pid_t pid;
+
+    pa_assert(pl);
+
+    if (!(pidstr = pa_proplist_gets(pl, PA_PROP_APPLICATION_PROCESS_ID)) ||
+        (pid = strtol(pidstr, NULL, 10)) < 2)
+        return 0;
+
+    return pid;
+}
+
+static void add_provisional_stream(struct userdata *u, pa_sink_input *sinp)
+{
+    pa_discover *discover;
+
+    pa_assert(u);
+    pa_assert(sinp);
+    pa_assert_se((discover = u->discover));
+
+    if (!pa_pidcache_is_pending(u, get_stream_pid(sinp->proplist))) {
+        /* resolved while the stream was being set up */
+        finalize_stream_class(u, sinp);
+        return;
+    }
+
+    if (discover->provisional.nindex >= discover->provisional.maxindex) {
+        discover->provisional.maxindex += 8;
+        discover->provisional.index =
+            pa_xrenew(uint32_t, discover->provisional.index,
+                      discover->provisional.maxindex);
+    }
+
+    discover->provisional.index[discover->provisional.nindex++] = sinp->index;
+}
+
+static void finalize_stream_class(struct userdata *u, pa_sink_input *sinp)
+{
+    pa_proplist       *pl;
+    mir_node          *node;
+    mir_node_type      type;
+    const char        *amname;
+    pa_nodeset_resdef *resdef = NULL;
+
+    pa_assert(u);
+    pa_assert(sinp);
+    pa_assert_se((pl = sinp->proplist));
+
+    pa_proplist_unset(pl, PA_PROP_ROUTING_PROVISIONAL);
+
+    if (!(node = pa_discover_find_node_by_ptr(u, sinp))) {
+        pa_log_debug("no node for provisional sink-input %u", sinp->index);
+        release_provisional_stream(u, sinp);
+        return;
+    }
+
+    type = pa_classify_guess_stream_node_type(u, pl, &resdef, false);
+
+    pa_utils_set_resource_properties(pl, resdef);
+
+    if (type && type != node->type) {
+        pa_log_debug("stream '%s' reclassified as '%s'",
+                     node->amname, mir_node_type_str(type));
+
+        pa_utils_set_stream_routing_properties(pl, type, NULL);
+
+        amname = get_stream_amname(type, pa_utils_get_sink_input_name(sinp),
+                                   pl);
+
+        /* the audio manager knows the node by its provisional name */
+        if (node->available)
+            pa_audiomgr_unregister_node(u, node);
+
+        mir_router_unregister_node(u, node);
+        node->type = type;
+        amname = pa_atom_get(u, amname);
+        pa_atom_unref(u, node->amname);
+        node->amname = amname;
+        mir_node_update_hot(u, node);
+        mir_router_register_node(u, node);
+
+        if (node->available)
+            pa_audiomgr_register_node(u, node);
+
+        pa_scheduler_request(u, PA_SCHEDULER_ROUTING);
+    }
+
+    /* let the clients know; the proplist hook drops the stale meta too */
+    pa_sink_input_update_proplist(sinp, PA_UPDATE_REPLACE, NULL);
+
+    if (!node->rset.id) {
+        if (resdef)
+            pa_murphyif_create_resource_set(u, node, resdef);
+        else {
+            node->rset.grant = 1;
+            pa_stream_state_change(u, node, PA_STREAM_RUN);
+        }
+    }
+}
+
+static void release_provisional_stream(struct userdata *u,
+                                       pa_sink_input *sinp)
+{
+    pa_assert(u);
+    pa_assert(sinp);
+
+    /* no final class will be settled; do not leave it corked for good */
+    pa_log_debug("releasing provisional sink-input %u", sinp->index);
+
+    pa_proplist_unset(sinp->proplist, PA_PROP_ROUTING_PROVISIONAL);
+    pa_sink_input_update_proplist(sinp, PA_UPDATE_REPLACE, NULL);
+
+    pa_stream_state_release(u, sinp);
+}
+
+static void fill_stream_meta(struct userdata *u,
+                             pa_sink_input *sinp,
+                             mir_stream_meta *meta)
+{
+    pa_proplist   *pl;
+    pa_sink_input *origin;
+    mir_node      *node;
+    const char    *method;
+    char           idbuf[512];
+
+    pa_assert(u);
+    pa_assert(sinp);
+    pa_assert(meta);
+    pa_assert_se((pl = sinp->proplist));
+
+    meta->class = pa_utils_get_stream_class(pl);
+
+    if (!(method = pa_proplist_gets(pl, PA_PROP_ROUTING_METHOD)))
+        meta->method = mir_routing_none;
+    else if (pa_streq(method, PA_ROUTING_EXPLICIT))
+        meta->method = mir_routing_explicit;
+    else if (pa_streq(method, PA_ROUTING_DEFAULT))
+        meta->method = mir_routing_default;
+    else
+        meta->method = mir_routing_none;
+
+    if ((origin = pa_utils_get_stream_origin(u, sinp))) {
+        meta->origin = origin->index;
+        node = pa_discover_find_node_by_ptr(u, origin);
+    }
+    else {
+        meta->origin = PA_IDXSET_INVALID;
+        node = NULL;
+    }
+
+    meta->node   = node ? node->index : PA_IDXSET_INVALID;
+    meta->rsetid = pa_xstrdup(pa_utils_get_rsetid(pl, idbuf, sizeof(idbuf)));
+}
+
+static bool stream_meta_is_valid(struct userdata *u, mir_stream_meta *meta)
+{
+    pa_core       *core;
+    pa_sink_input *origin;
+    mir_node      *node;
+
+    pa_assert(u);
+    pa_assert(meta);
+    pa_assert_se((core = u->core));
+
+    /*
+     * the origin of a multiplexed stream might come and go, or get its
+     * node later than the multiplexed stream was first seen. These are
+     * plain index and pointer lookups, no proplist parsing involved.
+     */
+    if (!(origin = pa_idxset_get_by_index(core->sink_inputs, meta->origin)))
+        return false;
+
+    node = pa_discover_find_node_by_ptr(u, origin);
+
+    return (node ? node->index : PA_IDXSET_INVALID) == meta->node;
+}
+
+static void free_stream_meta(mir_stream_meta *meta)
+{
+    if (meta) {
+        pa_xfree(meta->rsetid);
+        pa_xfree(meta);
+    }
+}
+
 static const char *get_stream_amname(mir_node_type type, const char *name, pa_proplist *pl)
 {
     const char *appid;
@@ -2408,7 +2806,7 @@ static const char *get_stream_amname(mir_node_type type, const char *name, pa_pr
     switch (type) {
 
     case mir_radio:
-        return pa_xstrdup("radio");
+        return "radio";
 
     case mir_player:
     case mir_game:
@@ -2524,30 +2922,138 @@ static void set_bluetooth_profile(struct userdata *u,
     }
 }
 
-static void deferred_routing_cb(pa_mainloop_api *m, void *d)
+void pa_discover_card_link_device(struct userdata *u,
+                                  mir_direction direction,
+                                  void *device)
 {
-    struct userdata *u = d;
+    pa_discover  *discover;
+    pa_card      *card;
+    card_devices *cd;
 
-    (void)m;
+    pa_assert(u);
+    pa_assert(device);
+    pa_assert(direction == mir_input || direction == mir_output);
+    pa_assert_se((discover = u->discover));
+
+    if (direction == mir_output)
+        card = ((pa_sink *)device)->card;
+    else
+        card = ((pa_source *)device)->card;
+
+    if (card) {
+        cd = card_devices_get(discover, card->index, true);
+
+        if (direction == mir_output)
+            pa_idxset_put(cd->sinks, device, NULL);
+        else
+            pa_idxset_put(cd->sources, device, NULL);
+    }
+}
+
+void pa_discover_card_unlink_device(struct userdata *u,
+                                    mir_direction direction,
+                                    void *device)
+{
+    pa_discover  *discover;
+    pa_card      *card;
+    card_devices *cd;
 
     pa_assert(u);
+    pa_assert(device);
+    pa_assert(direction == mir_input || direction == mir_output);
+    pa_assert_se((discover = u->discover));
 
-    pa_log_debug("deferred routing starts");
+    if (direction == mir_output)
+        card = ((pa_sink *)device)->card;
+    else
+        card = ((pa_source *)device)->card;
 
-    mir_router_make_routing(u);
+    if (card && (cd = card_devices_get(discover, card->index, false))) {
+        if (direction == mir_output)
+            pa_idxset_remove_by_data(cd->sinks, device, NULL);
+        else
+            pa_idxset_remove_by_data(cd->sources, device, NULL);
+    }
 }
 
+static card_devices *card_devices_get(pa_discover *discover,
+                                      uint32_t index,
+                                      bool create)
+{
+    card_devices *cd;
+
+    pa_assert(discover);
 
-static void schedule_deferred_routing(struct userdata *u)
+    cd = pa_hashmap_get(discover->cards, PA_UINT32_TO_PTR(index));
+
+    if (!cd && create) {
+        cd = pa_xnew0(card_devices, 1);
+        cd->index   = index;
+        cd->sinks   = pa_idxset_new(pa_idxset_trivial_hash_func,
+                                    pa_idxset_trivial_compare_func);
+        cd->sources = pa_idxset_new(pa_idxset_trivial_hash_func,
+                                    pa_idxset_trivial_compare_func);
+        cd->nodes   = pa_idxset_new(pa_idxset_trivial_hash_func,
+                                    pa_idxset_trivial_compare_func);
+
+        pa_hashmap_put(discover->cards, PA_UINT32_TO_PTR(index), cd);
+    }
+
+    return cd;
+}
+
+static void card_devices_free(pa_discover *discover, card_devices *cd)
 {
-    pa_core *core;
+    pa_assert(discover);
+    pa_assert(cd);
 
+    pa_hashmap_remove(discover->cards, PA_UINT32_TO_PTR(cd->index));
+
+    pa_idxset_free(cd->sinks, NULL);
+    pa_idxset_free(cd->sources, NULL);
+    pa_idxset_free(cd->nodes, NULL);
+
+    pa_xfree(cd);
+}
+
+static void card_index_add_node(pa_discover *discover, mir_node *node)
+{
+    card_devices *cd;
+
+    pa_assert(discover);
+    pa_assert(node);
+
+    if (node->implement == mir_device &&
+        node->pacard.index != PA_IDXSET_INVALID)
+    {
+        cd = card_devices_get(discover, node->pacard.index, true);
+        pa_idxset_put(cd->nodes, node, NULL);
+    }
+}
+
+static void card_index_remove_node(pa_discover *discover, mir_node *node)
+{
+    card_devices *cd;
+
+    pa_assert(discover);
+    pa_assert(node);
+
+    if (node->implement == mir_device &&
+        node->pacard.index != PA_IDXSET_INVALID &&
+        (cd = card_devices_get(discover, node->pacard.index, false)))
+    {
+        pa_idxset_remove_by_data(cd->nodes, node, NULL);
+    }
+}
+
+
+static void schedule_deferred_routing(struct userdata *u)
+{
     pa_assert(u);
-    pa_assert_se((core = u->core));
 
     pa_log_debug("scheduling deferred routing");
 
-    pa_mainloop_api_once(core->mainloop, deferred_routing_cb, u);
+    pa_scheduler_request(u, PA_SCHEDULER_ROUTING);
 }
 
 
@@ -2557,10 +3063,8 @@ static void card_check_cb(pa_mainloop_api *m, void *d)
     struct userdata *u;
     pa_core *core;
     pa_card *card;
-    pa_sink *sink;
-    pa_source *source;
+    card_devices *cd;
     int n_sink, n_source;
-    uint32_t idx;
 
     (void)m;
 
@@ -2573,17 +3077,12 @@ static void card_check_cb(pa_mainloop_api *m, void *d)
     if (!(card = pa_idxset_get_by_index(core->cards, cc->index)))
         pa_log_debug("card %u is gone", cc->index);
     else {
-        n_sink = n_source = 0;
-
-        PA_IDXSET_FOREACH(sink, core->sinks, idx) {
-            if ((sink->card) && sink->card->index == card->index)
-                n_sink++;
-        }
-
-        PA_IDXSET_FOREACH(source, core->sources, idx) {
-            if ((source->card) && source->card->index == card->index)
-                n_sink++;
+        if ((cd = card_devices_get(u->discover, card->index, false))) {
+            n_sink   = pa_idxset_size(cd->sinks);
+            n_source = pa_idxset_size(cd->sources);
         }
+        else
+            n_sink = n_source = 0;
 
         if (n_sink || n_source) {
             pa_log_debug("found %u sinks and %u sources belonging to "
@@ -2593,7 +3092,7 @@ static void card_check_cb(pa_mainloop_api *m, void *d)
         else {
             pa_log_debug("card '%s' has no sinks/sources. Do routing ...",
                          card->name);
-            mir_router_make_routing(u);
+            pa_scheduler_request(u, PA_SCHEDULER_ROUTING);
         }
     }
 
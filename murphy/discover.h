@@ -54,6 +54,25 @@ enum pa_form_factor {
 };
 #endif
 
+typedef enum {
+    mir_routing_none = 0,
+    mir_routing_default,
+    mir_routing_explicit,
+} mir_routing_method;
+
+/*
+ * typed copy of the routing related sink-input properties. The
+ * volume limiting loops run over every sink-input of every sink so
+ * they should not parse proplists over and over again.
+ */
+struct mir_stream_meta {
+    int                 class;  /**< routing.class.id or 0 if unclassified */
+    mir_routing_method  method; /**< routing.method */
+    uint32_t            origin; /**< index of the originating sink-input */
+    uint32_t            node;   /**< index of the node of the origin */
+    char               *rsetid; /**< resource set id or NULL */
+};
+
 struct pa_discover {
     /*
      * cirteria for filtering sinks and sources
@@ -67,6 +86,15 @@ struct pa_discover {
         pa_hashmap *byname;
         pa_hashmap *byptr;
     }               nodes;
+    pa_hashmap     *streams;  /**< mir_stream_meta's by sink-input ptr */
+    pa_hashmap     *cards;    /**< sinks, sources and device nodes
+                                   by card index */
+    struct {
+        size_t      nindex;
+        size_t      maxindex;
+        uint32_t   *index;    /**< sink-inputs waiting for their process
+                                   identity to be resolved */
+    }               provisional;
 };
 
 
@@ -82,6 +110,9 @@ void pa_discover_profile_changed(struct userdata *, pa_card *);
 
 void pa_discover_port_available_changed(struct userdata *, pa_device_port *);
 
+void pa_discover_card_link_device(struct userdata *, mir_direction, void *);
+void pa_discover_card_unlink_device(struct userdata *, mir_direction, void *);
+
 void pa_discover_add_sink(struct userdata *, pa_sink *, bool);
 void pa_discover_remove_sink(struct userdata *, pa_sink *);
 
@@ -101,12 +132,18 @@ void pa_discover_add_source_output(struct userdata *, pa_source_output *);
 void pa_discover_remove_source_output(struct userdata *, pa_source_output *);
 
 
+void pa_discover_process_resolved(struct userdata *, pid_t);
+
 mir_node *pa_discover_find_node_by_key(struct userdata *, const char *);
 mir_node *pa_discover_find_node_by_ptr(struct userdata *, void *);
 
 void pa_discover_add_node_to_ptr_hash(struct userdata *, void *, mir_node *);
 mir_node *pa_discover_remove_node_from_ptr_hash(struct userdata *, void *);
 
+mir_stream_meta *pa_discover_get_stream_meta(struct userdata *,
+                                             pa_sink_input *);
+void pa_discover_invalidate_stream_meta(struct userdata *, pa_sink_input *);
+
 #endif
 
 
@@ -32,6 +32,9 @@
 #include "extapi.h"
 #include "node.h"
 #include "router.h"
+#include "scheduler.h"
+#include "slab.h"
+#include "pidcache.h"
 
 enum {
     SUBCOMMAND_TEST,
@@ -39,7 +42,9 @@ enum {
     SUBCOMMAND_CONNECT,
     SUBCOMMAND_DISCONNECT,
     SUBCOMMAND_SUBSCRIBE,
-    SUBCOMMAND_EVENT
+    SUBCOMMAND_EVENT,
+    SUBCOMMAND_READ_ROUTING_PLAN,
+    SUBCOMMAND_READ_STATS
 };
 
 struct pa_nodeset {
@@ -288,6 +293,68 @@ int extension_cb(pa_native_protocol *p, pa_module *m, pa_native_connection *c, u
         break;
     }
 
+    case SUBCOMMAND_READ_ROUTING_PLAN: {
+        mir_rtplan *plan, *diff;
+        mir_rtplan_entry *e;
+        size_t nentry;
+        size_t i;
+        int z;
+
+        if (!pa_tagstruct_eof(t))
+            goto fail;
+
+        pa_log_debug("got routing plan read request to module-murphy-ivi");
+
+        diff = &u->router->diff;
+
+        for (nentry = 0, z = 0;  z < MRP_ZONE_MAX;  z++)
+            nentry += u->router->shards[z].plan.nentry;
+
+        pa_tagstruct_putu32(reply, (uint32_t)nentry);
+
+        for (z = 0;  z < MRP_ZONE_MAX;  z++) {
+            plan = &u->router->shards[z].plan;
+
+            for (i = 0;  i < plan->nentry;  i++) {
+                e = plan->entries + i;
+                pa_tagstruct_putu32(reply, e->node);
+                pa_tagstruct_putu32(reply, e->target);
+            }
+        }
+
+        pa_tagstruct_putu32(reply, (uint32_t)diff->nentry);
+
+        for (i = 0;  i < diff->nentry;  i++) {
+            e = diff->entries + i;
+            pa_tagstruct_putu32(reply, e->node);
+            pa_tagstruct_putu32(reply, e->prev);
+            pa_tagstruct_putu32(reply, e->target);
+        }
+
+        break;
+    }
+
+    case SUBCOMMAND_READ_STATS: {
+        pa_proplist *stats;
+
+        if (!pa_tagstruct_eof(t))
+            goto fail;
+
+        pa_log_debug("got statistics read request to module-murphy-ivi");
+
+        /* collected on demand, to keep them off the main loop's path */
+        stats = pa_proplist_new();
+
+        pa_scheduler_publish_stats(u, stats);
+        pa_slabset_publish_stats(u, stats);
+        pa_pidcache_publish_stats(u, stats);
+
+        pa_tagstruct_put_proplist(reply, stats);
+        pa_proplist_free(stats);
+
+        break;
+    }
+
     default:
       goto fail;
   }
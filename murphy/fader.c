@@ -33,6 +33,7 @@
 #include "node.h"
 #include "discover.h"
 #include "volume.h"
+#include "loopback.h"
 #include "utils.h"
 
 typedef struct {
@@ -43,15 +44,25 @@ typedef struct {
 
 struct pa_fader {
     transition_time transit;
+    pa_idxset      *dirty;      /**< index+1 of the sinks to be updated */
+    bool            all;        /**< all sinks needs to be updated */
+    bool            full;       /**< ... even if their class mask is kept */
 };
 
-static void set_stream_volume_limit(struct userdata *, pa_sink_input *,
+static void apply_sink_volume_limits(struct userdata *, pa_sink *,
+                                     uint32_t, bool);
+static bool set_stream_volume_limit(struct userdata *, pa_sink_input *,
                                     pa_volume_t, long);
+static void sync_sink_volumes(struct userdata *, pa_sink *);
 
 pa_fader *pa_fader_init(const char *fade_out_str, const char *fade_in_str)
 {
     pa_fader *fader = pa_xnew0(pa_fader, 1);
 
+    fader->dirty = pa_idxset_new(pa_idxset_trivial_hash_func,
+                                 pa_idxset_trivial_compare_func);
+    fader->all = true;
+
     if (!fade_out_str || pa_atol(fade_out_str, &fader->transit.fade_out) < 0)
         fader->transit.fade_out = 100;
 
@@ -72,8 +83,12 @@ pa_fader *pa_fader_init(const char *fade_out_str, const char *fade_in_str)
 
 void pa_fader_done(struct userdata *u)
 {
-    if (u) {
-        pa_xfree(u->fader);
+    pa_fader *fader;
+
+    if (u && (fader = u->fader)) {
+        pa_idxset_free(fader->dirty, NULL);
+        pa_xfree(fader);
+        u->fader = NULL;
     }
 }
 
@@ -81,119 +96,135 @@ void pa_fader_done(struct userdata *u)
 
 void pa_fader_apply_volume_limits(struct userdata *u, uint32_t stamp)
 {
-    pa_core         *core;
-    transition_time *transit;
-    pa_sink         *sink;
-    pa_sink_input   *sinp, *origin;
-    pa_cvolume_ramp_int  *ramp;
-    mir_node        *device_node;
-    mir_node        *stream_node;
-    double           dB;
-    pa_volume_t      newvol;
-    pa_volume_t      oldvol;
-    long             time;
-    uint32_t         i,j;
-    int              class;
-    bool             rampit;
-    bool             corked;
-    bool             muted;
-    uint32_t         mask;
+    pa_core  *core;
+    pa_fader *fader;
+    pa_sink  *sink;
+    uint32_t  i;
 
     pa_assert(u);
-    pa_assert_se(u->fader);
+    pa_assert_se((fader = u->fader));
     pa_assert_se((core = u->core));
 
-    transit = &u->fader->transit;
-    rampit  = transit->fade_in > 0 &&  transit->fade_out > 0;
-
     pa_log_debug("applying volume limits ...");
 
     PA_IDXSET_FOREACH(sink, core->sinks, i) {
-        if ((device_node = pa_discover_find_node_by_ptr(u, sink))) {
-            pa_log_debug("   node '%s'", device_node->amname);
-
-            mask = 0;
-
-            PA_IDXSET_FOREACH(sinp, sink->inputs, j) {
-                origin = pa_utils_get_stream_origin(u, sinp);
-                stream_node = pa_discover_find_node_by_ptr(u, origin);
-
-                if (origin == NULL) {
-                    pa_log_debug("could not find origin for sink-input %d", sinp->index);
-                }
-                else if ((class = pa_utils_get_stream_class(sinp->proplist)) > 0) {
-
-                    corked = stream_node ? !stream_node->rset.grant : false;
-                    muted  = (sinp->muted  || pa_hashmap_get(sinp->volume_factor_items,
-                                                             "internal_mute"));
-                    if (origin != sinp) {
-                        muted |= (origin->muted || pa_hashmap_get(origin->volume_factor_items,
-                                                                  "internal_mute"));
-                    }
-
-                    if (!corked && !muted)
-                        mask |= mir_volume_get_class_mask(class);
-
-                    pa_log_debug("*** stream %u (origin %u) class: %d corked: %s muted: %s "
-                                 "(sinp:%s internal:%s)", sinp->index, origin->index,
-                                 class, corked?"yes":"no ",
-                           muted?"yes":"no", sinp->muted ? "yes":"no",
-                           pa_hashmap_get(sinp->volume_factor_items,"internal_mute")?"yes":"no");
-                }
-                else
-                    pa_log_debug("*** steam %u (origin %u) class: %d", sinp->index, origin->index, class);
-            }
+        apply_sink_volume_limits(u, sink, stamp, true);
+    }
+
+    pa_idxset_remove_all(fader->dirty, NULL);
+    fader->all = false;
+    fader->full = false;
+}
+
+void pa_fader_update_volume_limits(struct userdata *u)
+{
+    pa_core  *core;
+    pa_fader *fader;
+    pa_sink  *sink;
+    void     *idx;
+    uint32_t  stamp;
+    uint32_t  i;
 
-            pa_log_debug("*** mask: 0x%x", mask);
-
-            PA_IDXSET_FOREACH(sinp, sink->inputs, j) {
-                class = pa_utils_get_stream_class(sinp->proplist);
-
-                pa_log_debug("     stream %u (class %u)", sinp->index, class);
-
-                if (!class) {
-                    if (!(sinp->flags & PA_SINK_INPUT_START_RAMP_MUTED))
-                        pa_log_debug("        skipping");
-                    else {
-                        sinp->flags &= ~((unsigned int)PA_SINK_INPUT_START_RAMP_MUTED);
-                        time = transit->fade_in;
-
-                        pa_log_debug("        attenuation 0 dB "
-                                     "transition time %ld ms", time);
-                        set_stream_volume_limit(u, sinp, PA_VOLUME_NORM, time);
-                    }
-                }
-                else {
-                    dB = mir_volume_apply_limits(u, device_node, mask, class, stamp);
-                    newvol = pa_sw_volume_from_dB(dB);
-
-                    if (rampit) {
-                        ramp   = &sinp->ramp;
-                        oldvol = ramp->ramps[0].target;
-
-                        if (oldvol > newvol)
-                            time = transit->fade_out;
-                        else if (oldvol < newvol)
-                            time = transit->fade_in;
-                        else
-                            time = 0;
-                    }
-                    else {
-                        oldvol = sinp->volume_factor.values[0];
-                        time = 0;
-                    }
-
-                    if (oldvol == newvol)
-                        pa_log_debug("         attenuation %.2lf dB",dB);
-                    else {
-                        pa_log_debug("         attenuation %.2lf dB "
-                                     "transition time %ld ms", dB, time);
-                        set_stream_volume_limit(u, sinp, newvol, time);
-                    }
-                }
-            } /* PA_IDXSET_FOREACH sinp */
+    pa_assert(u);
+    pa_assert_se((fader = u->fader));
+    pa_assert_se((core = u->core));
+
+    stamp = pa_utils_get_stamp();
+
+    if (fader->all) {
+        pa_log_debug("updating volume limits on all devices ...");
+
+        PA_IDXSET_FOREACH(sink, core->sinks, i) {
+            apply_sink_volume_limits(u, sink, stamp, fader->full);
         }
-    } /* PA_IDXSET_FOREACH sink */
+
+        pa_idxset_remove_all(fader->dirty, NULL);
+        fader->all = false;
+        fader->full = false;
+    }
+    else {
+        pa_log_debug("updating volume limits on %u device(s) ...",
+                     pa_idxset_size(fader->dirty));
+
+        while ((idx = pa_idxset_steal_first(fader->dirty, NULL))) {
+            if ((sink = pa_idxset_get_by_index(core->sinks, PA_PTR_TO_UINT(idx)-1)))
+                apply_sink_volume_limits(u, sink, stamp, false);
+        }
+    }
+}
+
+void pa_fader_apply_sink_volume_limits(struct userdata *u, pa_sink *sink)
+{
+    pa_fader *fader;
+
+    pa_assert(u);
+    pa_assert(sink);
+    pa_assert_se((fader = u->fader));
+
+    pa_log_debug("applying volume limits on sink '%s' ...", sink->name);
+
+    apply_sink_volume_limits(u, sink, pa_utils_get_stamp(), true);
+
+    pa_idxset_remove_by_data(fader->dirty, PA_UINT_TO_PTR(sink->index+1),
+                             NULL);
+}
+
+void pa_fader_mark_sink_dirty(struct userdata *u, pa_sink *sink, bool force)
+{
+    pa_fader *fader;
+    mir_node *node;
+
+    pa_assert(u);
+    pa_assert_se((fader = u->fader));
+
+    if (sink) {
+        /* idxset can't hold NULL, ie. index 0, so the keys are offset by 1 */
+        pa_idxset_put(fader->dirty, PA_UINT_TO_PTR(sink->index+1), NULL);
+
+        if (force && (node = pa_discover_find_node_by_ptr(u, sink)))
+            node->vlim.applied = false;
+    }
+}
+
+void pa_fader_mark_node_dirty(struct userdata *u,
+                              mir_node *node,
+                              bool force)
+{
+    pa_core       *core;
+    pa_fader      *fader;
+    pa_sink       *sink;
+    pa_sink_input *sinp;
+    uint32_t       idx;
+
+    pa_assert(u);
+    pa_assert(node);
+    pa_assert_se((fader = u->fader));
+    pa_assert_se((core = u->core));
+
+    if (node->direction == mir_output) {
+        if (node->implement == mir_device) {
+            sink = pa_idxset_get_by_index(core->sinks, node->paidx);
+            pa_fader_mark_sink_dirty(u, sink, force);
+        }
+        return;
+    }
+
+    if (node->mux) {
+        /* the streams of a multiplexer can be all over the place */
+        fader->all = true;
+        fader->full |= force;
+        return;
+    }
+
+    if (node->loop)
+        idx = node->loop->sink_input_index;
+    else if (node->implement == mir_stream)
+        idx = node->paidx;
+    else
+        return;
+
+    if ((sinp = pa_idxset_get_by_index(core->sink_inputs, idx)))
+        pa_fader_mark_sink_dirty(u, sinp->sink, force);
 }
 
 void pa_fader_ramp_volume(struct userdata *u,
@@ -267,7 +298,147 @@ pa_volume_t pa_fader_get_volume(struct userdata *u, pa_sink_input *sinp)
     return vol;
 }
 
-static void set_stream_volume_limit(struct userdata *u,
+static void apply_sink_volume_limits(struct userdata *u,
+                                     pa_sink         *sink,
+                                     uint32_t         stamp,
+                                     bool             full)
+{
+    pa_core         *core;
+    transition_time *transit;
+    pa_sink_input   *sinp, *origin;
+    pa_cvolume_ramp_int  *ramp;
+    mir_node        *device_node;
+    mir_node        *stream_node;
+    mir_stream_meta *meta;
+    double           dB;
+    pa_volume_t      newvol;
+    pa_volume_t      oldvol;
+    long             time;
+    uint32_t         j;
+    int              class;
+    bool             rampit;
+    bool             corked;
+    bool             muted;
+    bool             sync;
+    uint32_t         mask;
+
+    pa_assert(u);
+    pa_assert(sink);
+    pa_assert_se(u->fader);
+    pa_assert_se((core = u->core));
+
+    if (!(device_node = pa_discover_find_node_by_ptr(u, sink)))
+        return;
+
+    transit = &u->fader->transit;
+    rampit  = transit->fade_in > 0 &&  transit->fade_out > 0;
+
+    pa_log_debug("   node '%s'", device_node->amname);
+
+    mask = 0;
+
+    PA_IDXSET_FOREACH(sinp, sink->inputs, j) {
+        meta = pa_discover_get_stream_meta(u, sinp);
+        origin = pa_idxset_get_by_index(core->sink_inputs, meta->origin);
+        stream_node = mir_node_find_by_index(u, meta->node);
+
+        if (origin == NULL) {
+            pa_log_debug("could not find origin for sink-input %d", sinp->index);
+        }
+        else if ((class = meta->class) > 0) {
+
+            corked = stream_node ? !stream_node->rset.grant : false;
+            muted  = (sinp->muted  || pa_hashmap_get(sinp->volume_factor_items,
+                                                     "internal_mute"));
+            if (origin != sinp) {
+                muted |= (origin->muted || pa_hashmap_get(origin->volume_factor_items,
+                                                          "internal_mute"));
+            }
+
+            if (!corked && !muted)
+                mask |= mir_volume_get_class_mask(class);
+
+            pa_log_debug("*** stream %u (origin %u) class: %d corked: %s muted: %s "
+                         "(sinp:%s internal:%s)", sinp->index, origin->index,
+                         class, corked?"yes":"no ",
+                   muted?"yes":"no", sinp->muted ? "yes":"no",
+                   pa_hashmap_get(sinp->volume_factor_items,"internal_mute")?"yes":"no");
+        }
+        else
+            pa_log_debug("*** steam %u (origin %u) class: %d", sinp->index, origin->index, class);
+    }
+
+    pa_log_debug("*** mask: 0x%x", mask);
+
+    if (!full && device_node->vlim.applied && mask == device_node->vlim.actmask) {
+        pa_log_debug("     class mask did not change. skipping");
+        return;
+    }
+
+    device_node->vlim.actmask = mask;
+    device_node->vlim.applied = true;
+
+    sync = false;
+
+    PA_IDXSET_FOREACH(sinp, sink->inputs, j) {
+        class = pa_discover_get_stream_meta(u, sinp)->class;
+
+        pa_log_debug("     stream %u (class %u)", sinp->index, class);
+
+        if (!class) {
+            if (!(sinp->flags & PA_SINK_INPUT_START_RAMP_MUTED))
+                pa_log_debug("        skipping");
+            else {
+                sinp->flags &= ~((unsigned int)PA_SINK_INPUT_START_RAMP_MUTED);
+                time = transit->fade_in;
+
+                pa_log_debug("        attenuation 0 dB "
+                             "transition time %ld ms", time);
+                sync |= set_stream_volume_limit(u, sinp, PA_VOLUME_NORM, time);
+            }
+        }
+        else {
+            dB = mir_volume_apply_limits(u, device_node, mask, class, stamp);
+            newvol = pa_sw_volume_from_dB(dB);
+
+            if (rampit) {
+                ramp   = &sinp->ramp;
+                oldvol = ramp->ramps[0].target;
+
+                if (oldvol > newvol)
+                    time = transit->fade_out;
+                else if (oldvol < newvol)
+                    time = transit->fade_in;
+                else
+                    time = 0;
+            }
+            else {
+                oldvol = sinp->volume_factor.values[0];
+                time = 0;
+            }
+
+            if (oldvol == newvol)
+                pa_log_debug("         attenuation %.2lf dB",dB);
+            else {
+                pa_log_debug("         attenuation %.2lf dB "
+                             "transition time %ld ms", dB, time);
+                sync |= set_stream_volume_limit(u, sinp, newvol, time);
+            }
+        }
+    } /* PA_IDXSET_FOREACH sinp */
+
+    if (sync)
+        sync_sink_volumes(u, sink);
+}
+
+/*
+ * Instant volume changes are only made on the main thread side here.
+ * Returns true if the sink needs to be synced with sync_sink_volumes()
+ * so that all the streams of a sink get updated with a single message
+ * to the IO thread. Ramps are posted to the IO thread without waiting,
+ * so it picks up the ramps of all the streams in one wakeup.
+ */
+static bool set_stream_volume_limit(struct userdata *u,
                                     pa_sink_input   *sinp,
                                     pa_volume_t      vol,
                                     long             ramp_time)
@@ -282,26 +453,39 @@ static void set_stream_volume_limit(struct userdata *u,
     if (!ramp_time) {
         pa_cvolume_set(&sinp->volume_factor, sinp->volume.channels, vol);
 
-        if (pa_sink_flat_volume_enabled(sink)) {
-            pa_sink_set_volume(sink, NULL, true, false);
-        }
-        else {
+        if (!pa_sink_flat_volume_enabled(sink)) {
             pa_sw_cvolume_multiply(&sinp->soft_volume, &sinp->real_ratio,
                                    &sinp->volume_factor);
-
-            pa_asyncmsgq_send(sink->asyncmsgq, PA_MSGOBJECT(sinp),
-                              PA_SINK_INPUT_MESSAGE_SET_SOFT_VOLUME,
-                              NULL, 0, NULL);
         }
+
+        return true;
     }
-    else {
-        pa_cvolume_ramp_set(&rampvol,
-                            sinp->volume.channels,
-                            PA_VOLUME_RAMP_TYPE_LINEAR,
-                            ramp_time,
-                            vol);
 
-        pa_sink_input_set_volume_ramp(sinp, &rampvol, true, false);
+    pa_cvolume_ramp_set(&rampvol,
+                        sinp->volume.channels,
+                        PA_VOLUME_RAMP_TYPE_LINEAR,
+                        ramp_time,
+                        vol);
+
+    pa_sink_input_set_volume_ramp(sinp, &rampvol, false, false);
+
+    pa_asyncmsgq_post(sink->asyncmsgq, PA_MSGOBJECT(sinp),
+                      PA_SINK_INPUT_MESSAGE_SET_VOLUME_RAMP, NULL, 0,
+                      NULL, NULL);
+
+    return false;
+}
+
+static void sync_sink_volumes(struct userdata *u, pa_sink *sink)
+{
+    pa_assert(u);
+    pa_assert(sink);
+
+    if (pa_sink_flat_volume_enabled(sink))
+        pa_sink_set_volume(sink, NULL, true, false);
+    else {
+        pa_asyncmsgq_send(sink->asyncmsgq, PA_MSGOBJECT(sink),
+                          PA_SINK_MESSAGE_SYNC_VOLUMES, NULL, 0, NULL);
     }
 }
 
@@ -30,6 +30,11 @@ pa_fader *pa_fader_init(const char *, const char *);
 void pa_fader_done(struct userdata *);
 
 void pa_fader_apply_volume_limits(struct userdata *, uint32_t);
+void pa_fader_update_volume_limits(struct userdata *);
+void pa_fader_apply_sink_volume_limits(struct userdata *, pa_sink *);
+
+void pa_fader_mark_sink_dirty(struct userdata *, pa_sink *, bool);
+void pa_fader_mark_node_dirty(struct userdata *, mir_node *, bool);
 
 void pa_fader_ramp_volume(struct userdata *, pa_sink_input *, pa_volume_t);
 void pa_fader_set_volume(struct userdata *, pa_sink_input *, pa_volume_t);
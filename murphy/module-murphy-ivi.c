@@ -33,6 +33,7 @@
 #include <pulsecore/pulsecore-config.h>
 
 #include <pulse/timeval.h>
+#include <pulse/rtclock.h>
 #include <pulse/xmalloc.h>
 
 #include <pulsecore/macro.h>
@@ -65,6 +66,10 @@
 #include "murphyif.h"
 #include "resource.h"
 #include "classify.h"
+#include "scheduler.h"
+#include "slab.h"
+#include "atom.h"
+#include "pidcache.h"
 
 #ifndef DEFAULT_CONFIG_DIR
 #define DEFAULT_CONFIG_DIR "/etc/pulse"
@@ -79,6 +84,8 @@
 #define WITH_RESOURCES
 #endif
 
+#define STARTUP_MSEC(t)  ((double)(t) / PA_USEC_PER_MSEC)
+
 
 PA_MODULE_AUTHOR("Janos Kovacs");
 PA_MODULE_DESCRIPTION("Murphy and GenIVI compliant audio policy module");
@@ -90,6 +97,10 @@ PA_MODULE_USAGE(
     "fade_out=<stream fade-out time in msec> "
     "fade_in=<stream fade-in time in msec> "
     "enable_multiplex=<boolean for disabling combine creation> "
+    "verify_routing=<boolean for cross-checking incremental routing> "
+    "batch_window=<event collection time in msec before routing> "
+    "async_classify=<boolean for resolving stream processes in a thread> "
+    "batch_accept=<boolean for evaluating rtgroup accepts in one Lua call> "
 #ifdef WITH_DOMCTL
     "murphy_domain_controller=<address of Murphy's domain controller service> "
 #endif
@@ -117,6 +128,10 @@ static const char* const valid_modargs[] = {
     "fade_out",
     "fade_in",
     "enable_multiplex",
+    "verify_routing",
+    "batch_window",
+    "async_classify",
+    "batch_accept",
 #ifdef WITH_DOMCTL
     "murphy_domain_controller",
 #endif
@@ -147,6 +162,7 @@ int pa__init(pa_module *m) {
     const char      *cfgfile;
     const char      *fadeout;
     const char      *fadein;
+    const char      *batchwin;
 #ifdef WITH_DOMCTL
     const char      *ctladdr;
 #endif
@@ -166,10 +182,17 @@ int pa__init(pa_module *m) {
     const char      *cfgpath;
     char             buf[4096];
     bool             enable_multiplex = true;
+    bool             verify_routing = false;
+    bool             async_classify = false;
+    bool             batch_accept = true;
+    pa_usec_t        start, now;
+    pa_usec_t        lua, config, sync, route;
 
 
     pa_assert(m);
 
+    start = pa_rtclock_now();
+
     if (!(ma = pa_modargs_new(m->argument, valid_modargs))) {
         pa_log("Failed to parse module arguments.");
         goto fail;
@@ -179,10 +202,20 @@ int pa__init(pa_module *m) {
     cfgfile  = pa_modargs_get_value(ma, "config_file", DEFAULT_CONFIG_FILE);
     fadeout  = pa_modargs_get_value(ma, "fade_out", NULL);
     fadein   = pa_modargs_get_value(ma, "fade_in", NULL);
+    batchwin = pa_modargs_get_value(ma, "batch_window", NULL);
 
     if (pa_modargs_get_value_boolean(ma, "enable_multiplex", &enable_multiplex) < 0)
         enable_multiplex = true;
 
+    if (pa_modargs_get_value_boolean(ma, "verify_routing", &verify_routing) < 0)
+        verify_routing = false;
+
+    if (pa_modargs_get_value_boolean(ma, "async_classify", &async_classify) < 0)
+        async_classify = false;
+
+    if (pa_modargs_get_value_boolean(ma, "batch_accept", &batch_accept) < 0)
+        batch_accept = true;
+
 #ifdef WITH_DOMCTL
     ctladdr  = pa_modargs_get_value(ma, "murphy_domain_controller", NULL);
 #endif
@@ -203,6 +236,10 @@ int pa__init(pa_module *m) {
     u = pa_xnew0(struct userdata, 1);
     u->core      = m->core;
     u->module    = m;
+    u->slabs     = pa_slabset_init(u);
+    u->atoms     = pa_atomset_init(u);
+    u->scheduler = pa_scheduler_init(u, batchwin);
+    u->pidcache  = pa_pidcache_init(u, async_classify);
     u->nullsink  = pa_utils_create_null_sink(u, nsnam);
     u->zoneset   = pa_zoneset_init(u);
     u->nodeset   = pa_nodeset_init(u);
@@ -214,13 +251,15 @@ int pa__init(pa_module *m) {
 #endif
     u->discover  = pa_discover_init(u);
     u->tracker   = pa_tracker_init(u);
-    u->router    = pa_router_init(u);
+    u->router    = pa_router_init(u, verify_routing, batch_accept);
     u->constrain = pa_constrain_init(u);
     u->multiplex = pa_multiplex_init();
     u->loopback  = pa_loopback_init();
     u->fader     = pa_fader_init(fadeout, fadein);
     u->volume    = pa_mir_volume_init(u);
+    lua = pa_rtclock_now();
     u->scripting = pa_scripting_init(u);
+    lua = pa_rtclock_now() - lua;
     u->config    = pa_mir_config_init(u);
     u->extapi    = pa_extapi_init(u);
     u->murphyif  = pa_murphyif_init(u, ctladdr, resaddr);
@@ -244,9 +283,29 @@ int pa__init(pa_module *m) {
 
     cfgpath = pa_utils_file_path(cfgdir, cfgfile, buf, sizeof(buf));
 
+    config = pa_rtclock_now();
     pa_mir_config_parse_file(u, cfgpath);
-
+    config = (now = pa_rtclock_now()) - config;
+
+    /*
+     * the existing cards, devices and streams get their nodes and rtgroup
+     * memberships first; routing, volume limits and resource policies run
+     * only once, when the bulk load ends
+     */
+    pa_scheduler_bulk_begin(u);
     pa_tracker_synchronize(u);
+    sync = (route = pa_rtclock_now()) - now;
+    pa_scheduler_bulk_end(u);
+    route = (now = pa_rtclock_now()) - route;
+
+    pa_log_info("startup took %.1f ms: Lua init %.1f ms, config parse %.1f ms,"
+                " sync %.1f ms, first route %.1f ms",
+                STARTUP_MSEC(now - start), STARTUP_MSEC(lua),
+                STARTUP_MSEC(config), STARTUP_MSEC(sync),
+                STARTUP_MSEC(route));
+    pa_log_info("rtgroup membership of %u node(s) took %.1f ms (%s accept)",
+                u->router->accept.nnode, STARTUP_MSEC(u->router->accept.time),
+                batch_accept ? "batched" : "per-group");
 
     mir_router_print_rtgroups(u, buf, sizeof(buf));
     pa_log_debug("%s", buf);
@@ -274,6 +333,8 @@ void pa__done(pa_module *m) {
         pa_resource_done(u);
         pa_murphyif_done(u);
         pa_tracker_done(u);
+        pa_scheduler_done(u);
+        pa_pidcache_done(u);
         pa_discover_done(u);
         pa_constrain_done(u);
         pa_router_done(u);
@@ -291,6 +352,8 @@ void pa__done(pa_module *m) {
         pa_multiplex_done(u->multiplex, u->core);
 
         pa_extapi_done(u);
+        pa_atomset_done(u);
+        pa_slabset_done(u);
 
         if (u->protocol) {
             pa_native_protocol_remove_ext(u->protocol, m);
@@ -40,6 +40,7 @@ typedef struct {
     const char            *name;
     mir_rtgroup_accept_t   accept;
     mir_rtgroup_compare_t  compare;
+    mir_rtgroup_sortkey_t  sortkey;
 } rtgroup_def;
 
 typedef struct {
@@ -74,22 +75,25 @@ static rtgroup_def  rtgroups[] = {
     {mir_input,
      "phone",
      mir_router_phone_accept,
-     mir_router_phone_compare
+     mir_router_phone_compare,
+     mir_router_phone_sortkey
     },
 
     {mir_output,
      "default",
      mir_router_default_accept,
-     mir_router_default_compare
+     mir_router_default_compare,
+     mir_router_default_sortkey
     },
 
     {mir_output,
      "phone",
      mir_router_phone_accept,
-     mir_router_phone_compare
+     mir_router_phone_compare,
+     mir_router_phone_sortkey
     },
 
-    {0,NULL,NULL,NULL}
+    {0,NULL,NULL,NULL,NULL}
 };
 
 static classmap_def classmap[] = {
@@ -129,6 +133,14 @@ static typemap_def binmap[] = {
     {NULL, mir_node_type_unknown}
 };
 
+/* binaries that launch the real applications; these are looked up by pid */
+static const char *launchers[] = {
+    "threaded-ml",
+    "WebProcess",
+    "wrt_launchpad_daemon",
+    NULL
+};
+
 static prior_def priormap[] = {
     {mir_radio    , 1},
     {mir_player   , 1},
@@ -212,6 +224,7 @@ static bool use_default_configuration(struct userdata *u)
     classmap_def *c;
     typemap_def  *t;
     prior_def    *p;
+    const char  **l;
 
     pa_assert(u);
 
@@ -219,7 +232,8 @@ static bool use_default_configuration(struct userdata *u)
         pa_zoneset_add_zone(u, z->name, (uint32_t)(z - zones));
 
     for (r = rtgroups;  r->name;   r++)
-        mir_router_create_rtgroup(u, r->type, r->name, r->accept, r->compare);
+        mir_router_create_rtgroup(u, r->type, r->name, r->accept, r->compare,
+                                  r->sortkey);
 
     for (c = classmap;  c->rtgroup;  c++) {
         mir_router_assign_class_to_rtgroup(u, c->class, c->zone,
@@ -230,7 +244,12 @@ static bool use_default_configuration(struct userdata *u)
         pa_nodeset_add_role(u, t->id, t->type, NULL);
 
     for (t = binmap; t->id; t++)
-        pa_nodeset_add_binary(u, t->id, t->type, NULL, NULL);
+        pa_nodeset_add_binary(u, t->id, t->type, NULL, NULL, 0);
+
+    for (l = launchers;  *l;  l++) {
+        pa_nodeset_add_binary(u, *l, mir_browser, NULL, NULL,
+                              PA_NODESET_MAP_LAUNCHER);
+    }
 
     for (p = priormap;  p->class;  p++)
         mir_router_assign_class_priority(u, p->class, p->priority);
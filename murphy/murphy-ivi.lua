@@ -10,7 +10,7 @@ routing_group {
     accept = function(self, n)
         return (n.type ~= node.bluetooth_carkit and n.type ~= node.hdmi)
     end,
-    compare = builtin.method.compare_default
+    sort_key = builtin.method.sort_key_default
 }
 
 routing_group {
@@ -19,21 +19,21 @@ routing_group {
     accept = function(self, n)
         return (n.type == node.hdmi or n.name == 'Silent')
     end,
-    compare = builtin.method.compare_default
+    sort_key = builtin.method.sort_key_default
 }
 
 routing_group {
     name = "phone",
     node_type = node.input,
     accept = builtin.method.accept_phone,
-    compare = builtin.method.compare_phone
+    sort_key = builtin.method.sort_key_phone
 }
 
 routing_group {
     name = "phone",
     node_type = node.output,
     accept = builtin.method.accept_phone,
-    compare = builtin.method.compare_phone
+    sort_key = builtin.method.sort_key_phone
 }
 
 application_class {
@@ -124,7 +124,10 @@ application_class {
         output = { driver = routing_group.default_driver_output,
                passanger1 = routing_group.default_passanger1_output }
     },
-    roles = { browser = {0, "mandatory", "shared"} }
+    roles = { browser = {0, "mandatory", "shared"} },
+    binaries = { ['threaded-ml']          = "launcher",
+                 ['WebProcess']           = "launcher",
+                 ['wrt_launchpad_daemon'] = "launcher" }
 }
 
 
@@ -58,6 +58,7 @@
 #include "stream-state.h"
 #include "fader.h"
 #include "utils.h"
+#include "scheduler.h"
 
 #ifdef WITH_RESOURCES
 #define INVALID_ID       (~(uint32_t)0)
@@ -1207,8 +1208,7 @@ static void resource_set_notification(struct userdata *u,
     // if (nrset != pa_resource_get_number_of_resources(u, type))
         pa_resource_purge(u, updid, type);
 
-    pa_resource_enforce_policies(u, type);
-    pa_fader_apply_volume_limits(u, pa_utils_get_stamp());
+    pa_scheduler_request(u, PA_SCHEDULER_RESOURCE(type) | PA_SCHEDULER_VOLUME);
 }
 
 
@@ -18,6 +18,7 @@
  *
  */
 #include <stdio.h>
+#include <string.h>
 
 #include <pulsecore/pulsecore-config.h>
 
@@ -29,19 +30,55 @@
 #include "node.h"
 #include "discover.h"
 #include "router.h"
+#include "zone.h"
 #include "constrain.h"
 #include "scripting.h"
 #include "murphyif.h"
+#include "slab.h"
+#include "atom.h"
 
 #define APCLASS_DIM  (mir_application_class_end - mir_application_class_begin + 1)
 
+/*
+ * binaries are matched with a trie that is compiled from the binaries
+ * hashmap on the first lookup after a change. A binary name ending with
+ * '*' is a prefix rule; an exact match wins over any prefix rule and a
+ * longer prefix wins over a shorter one.
+ */
+typedef struct {
+    uint32_t        child;    /**< first child, 0 if none */
+    uint32_t        sibling;  /**< next sibling in ch order, 0 if none */
+    unsigned char   ch;
+    pa_nodeset_map *exact;    /**< binary equal to the path */
+    pa_nodeset_map *prefix;   /**< binaries starting with the path */
+} trie_node;
+
 struct pa_nodeset {
     pa_idxset      *nodes;
     pa_hashmap     *roles;
     pa_hashmap     *binaries;
+    trie_node      *trie;     /**< compiled binaries, root at 0 */
+    uint32_t        ntrie;
+    uint32_t        maxtrie;
+    bool            trie_dirty;
     const char     *class_name[APCLASS_DIM];
+    mir_node_hot   *hot;      /**< routing data of the nodes, by hotidx */
+    uint32_t        nhot;     /**< allocated length of hot */
+    uint32_t       *freehot;  /**< released slots of hot */
+    uint32_t        nfree;    /**< number of released slots */
 };
 
+#define HOT_TABLE_CHUNK  32
+#define TRIE_CHUNK       64
+
+static uint32_t hot_alloc(pa_nodeset *);
+static void hot_release(pa_nodeset *, uint32_t);
+
+static void trie_compile(pa_nodeset *);
+static void trie_insert(pa_nodeset *, const char *, pa_nodeset_map *);
+static uint32_t trie_child(pa_nodeset *, uint32_t, unsigned char);
+static pa_nodeset_map *trie_match(pa_nodeset *, const char *);
+
 static int print_map(pa_hashmap *, const char *, char *, int);
 
 pa_nodeset *pa_nodeset_init(struct userdata *u)
@@ -57,6 +94,8 @@ pa_nodeset *pa_nodeset_init(struct userdata *u)
                                pa_idxset_string_compare_func);
     ns->binaries = pa_hashmap_new(pa_idxset_string_hash_func,
                                   pa_idxset_string_compare_func);
+    ns->trie_dirty = true;
+
     return ns;
 }
 
@@ -83,10 +122,14 @@ void pa_nodeset_done(struct userdata *u)
         }
 
         pa_hashmap_free(ns->binaries);
+        pa_xfree(ns->trie);
 
         for (i = 0;  i < APCLASS_DIM;  i++)
             pa_xfree((void *)ns->class_name[i]);
 
+        pa_xfree(ns->hot);
+        pa_xfree(ns->freehot);
+
         free(ns);
     }
 }
@@ -203,7 +246,8 @@ int pa_nodeset_add_binary(struct userdata *u,
                           const char *bin,
                           mir_node_type type,
                           const char *role,
-                          pa_nodeset_resdef *resdef)
+                          pa_nodeset_resdef *resdef,
+                          uint32_t flags)
 {
     pa_nodeset *ns;
     pa_nodeset_map *map;
@@ -218,12 +262,15 @@ int pa_nodeset_add_binary(struct userdata *u,
     map->name = pa_xstrdup(bin);
     map->type = type;
     map->role = role ? pa_xstrdup(role) : NULL;
+    map->flags = flags;
 
     if (resdef) {
         map->resdef = pa_xnew(pa_nodeset_resdef, 1);
         memcpy(map->resdef, resdef, sizeof(pa_nodeset_resdef));
     }
 
+    ns->trie_dirty = true;
+
     return pa_hashmap_put(ns->binaries, (void *)map->name, map);
 }
 
@@ -240,6 +287,8 @@ void pa_nodeset_delete_binary(struct userdata *u, const char *bin)
         pa_xfree((void *)map->name);
         pa_xfree((void *)map->role);
         pa_xfree((void *)map->resdef);
+
+        ns->trie_dirty = true;
     }
 }
 
@@ -252,10 +301,14 @@ pa_nodeset_map *pa_nodeset_get_map_by_binary(struct userdata *u,
     pa_assert(u);
     pa_assert_se((ns = u->nodeset));
 
-    if (bin)
-        map = pa_hashmap_get(ns->binaries, bin);
-    else
+    if (!bin)
         map = NULL;
+    else {
+        if (ns->trie_dirty)
+            trie_compile(ns);
+
+        map = trie_match(ns, bin);
+    }
 
 
     return map;
@@ -310,24 +363,27 @@ mir_node *mir_node_create(struct userdata *u, mir_node *data)
     pa_assert(data->key);
     pa_assert(data->paname);
 
-    node = pa_xnew0(mir_node, 1);
+    node = pa_slab_alloc(u, PA_SLAB_NODE);
 
     pa_idxset_put(ns->nodes, node, &node->index);
+    node->hotidx = hot_alloc(ns);
 
-    node->key        = pa_xstrdup(data->key);
+    node->key        = pa_atom_get(u, data->key);
     node->direction  = data->direction;
     node->implement  = data->implement;
     node->channels   = data->channels;
     node->location   = data->location;
     node->privacy    = data->privacy;
     node->type       = data->type;
-    node->zone       = pa_xstrdup(data->zone);
+    node->zone       = pa_atom_get(u, data->zone);
+    node->zoneidx    = pa_zoneset_get_zone_index(u, data->zone);
     node->visible    = data->visible;
     node->available  = data->available;
-    node->amname     = pa_xstrdup(data->amname ? data->amname : data->paname);
-    node->amdescr    = pa_xstrdup(data->amdescr ? data->amdescr : "");
+    node->amname     = pa_atom_get(u, data->amname ? data->amname
+                                                   : data->paname);
+    node->amdescr    = pa_atom_get(u, data->amdescr ? data->amdescr : "");
     node->amid       = data->amid;
-    node->paname     = pa_xstrdup(data->paname);
+    node->paname     = pa_atom_get(u, data->paname);
     node->paidx      = data->paidx;
     node->mux        = data->mux;
     node->loop       = data->loop;
@@ -335,18 +391,22 @@ mir_node *mir_node_create(struct userdata *u, mir_node *data)
     node->rset.id    = data->rset.id ? pa_xstrdup(data->rset.id) : NULL;
     node->rset.grant = data->rset.grant;
     node->scripting  = pa_scripting_node_create(u, node);
+    node->rtend      = PA_IDXSET_INVALID;
+    node->cstrslot   = PA_IDXSET_INVALID;
     MIR_DLIST_INIT(node->rtentries);
     MIR_DLIST_INIT(node->rtprilist);
+    MIR_DLIST_INIT(node->rtzonlist);
     MIR_DLIST_INIT(node->constrains);
 
     if (node->implement == mir_device) {
         node->pacard.index = data->pacard.index;
         if (data->pacard.profile)
-            node->pacard.profile = pa_xstrdup(data->pacard.profile);
+            node->pacard.profile = pa_atom_get(u, data->pacard.profile);
         if (data->paport)
             node->paport = data->paport;
     }
 
+    mir_node_update_hot(u, node);
     mir_router_register_node(u, node);
 
     return node;
@@ -371,13 +431,17 @@ void mir_node_destroy(struct userdata *u, mir_node *node)
         pa_scripting_node_destroy(u, node);
 
         pa_idxset_remove_by_index(ns->nodes, node->index);
-
-        pa_xfree(node->key);
-        pa_xfree(node->zone);
-        pa_xfree(node->pacard.profile);
+        hot_release(ns, node->hotidx);
+
+        pa_atom_unref(u, node->key);
+        pa_atom_unref(u, node->zone);
+        pa_atom_unref(u, node->amname);
+        pa_atom_unref(u, node->amdescr);
+        pa_atom_unref(u, node->paname);
+        pa_atom_unref(u, node->pacard.profile);
         pa_xfree(node->rset.id);
 
-        pa_xfree(node);
+        pa_slab_free(u, PA_SLAB_NODE, node);
     }
 }
 
@@ -395,6 +459,48 @@ mir_node *mir_node_find_by_index(struct userdata *u, uint32_t nodidx)
 }
 
 
+void mir_node_update_hot(struct userdata *u, mir_node *node)
+{
+    pa_nodeset   *ns;
+    mir_node_hot *hot;
+    uint8_t       flags;
+
+    pa_assert(u);
+    pa_assert(node);
+    pa_assert_se((ns = u->nodeset));
+    pa_assert(node->hotidx < ns->nhot);
+
+    hot = ns->hot + node->hotidx;
+
+    flags = MIR_NODE_HOT_USED;
+
+    if (node->available)
+        flags |= MIR_NODE_HOT_AVAILABLE;
+    if (node->ignore)
+        flags |= MIR_NODE_HOT_IGNORE;
+    if (node->paidx != PA_IDXSET_INVALID || node->paport ||
+        node->type == mir_bluetooth_a2dp || node->type == mir_bluetooth_sco)
+        flags |= MIR_NODE_HOT_ROUTABLE;
+
+    hot->type     = node->type;
+    hot->flags    = flags;
+    hot->zone     = node->zoneidx < MRP_ZONE_MAX ?
+                    node->zoneidx : MIR_NODE_HOT_NOZONE;
+    hot->privacy  = node->privacy;
+    hot->location = node->location;
+    hot->channels = node->channels;
+}
+
+const mir_node_hot *mir_node_hot_table(struct userdata *u)
+{
+    pa_nodeset *ns;
+
+    pa_assert(u);
+    pa_assert_se((ns = u->nodeset));
+
+    return ns->hot;
+}
+
 int mir_node_print(mir_node *node, char *buf, int len)
 {
     char *p, *e;
@@ -523,6 +629,152 @@ const char *mir_privacy_str(mir_privacy privacy)
     }
 }
 
+static uint32_t hot_alloc(pa_nodeset *ns)
+{
+    uint32_t idx;
+    uint32_t i;
+
+    pa_assert(ns);
+
+    if (!ns->nfree) {
+        idx = ns->nhot;
+        ns->nhot += HOT_TABLE_CHUNK;
+
+        ns->hot = pa_xrealloc(ns->hot, sizeof(mir_node_hot) * ns->nhot);
+        ns->freehot = pa_xrealloc(ns->freehot, sizeof(uint32_t) * ns->nhot);
+
+        memset(ns->hot + idx, 0, sizeof(mir_node_hot) * HOT_TABLE_CHUNK);
+
+        /* lowest slots on the top, to keep the live part of hot dense */
+        for (i = ns->nhot;  i > idx;  i--)
+            ns->freehot[ns->nfree++] = i - 1;
+    }
+
+    return ns->freehot[--ns->nfree];
+}
+
+static void hot_release(pa_nodeset *ns, uint32_t idx)
+{
+    pa_assert(ns);
+    pa_assert(idx < ns->nhot);
+    pa_assert(ns->nfree < ns->nhot);
+
+    memset(ns->hot + idx, 0, sizeof(mir_node_hot));
+    ns->freehot[ns->nfree++] = idx;
+}
+
+static void trie_compile(pa_nodeset *ns)
+{
+    pa_nodeset_map *map;
+    void *state;
+
+    pa_assert(ns);
+
+    ns->ntrie = 0;
+    trie_child(ns, 0, 0); /* root */
+
+    PA_HASHMAP_FOREACH(map, ns->binaries, state)
+        trie_insert(ns, map->name, map);
+
+    ns->trie_dirty = false;
+
+    pa_log_debug("compiled %u binaries into %u trie nodes",
+                 pa_hashmap_size(ns->binaries), ns->ntrie);
+}
+
+static void trie_insert(pa_nodeset *ns, const char *name, pa_nodeset_map *map)
+{
+    size_t len, i;
+    uint32_t idx;
+    bool prefix;
+
+    pa_assert(ns);
+    pa_assert(name);
+
+    len = strlen(name);
+
+    if ((prefix = (len > 0 && name[len-1] == '*')))
+        len--;
+
+    for (idx = 0, i = 0;  i < len;  i++)
+        idx = trie_child(ns, idx, (unsigned char)name[i]);
+
+    if (prefix)
+        ns->trie[idx].prefix = map;
+    else
+        ns->trie[idx].exact = map;
+}
+
+static uint32_t trie_child(pa_nodeset *ns, uint32_t parent, unsigned char ch)
+{
+    trie_node *t;
+    uint32_t prev, idx, nidx;
+
+    pa_assert(ns);
+
+    prev = idx = 0;
+
+    if (ns->ntrie > 0) {
+        idx = ns->trie[parent].child;
+
+        while (idx && ns->trie[idx].ch < ch) {
+            prev = idx;
+            idx  = ns->trie[idx].sibling;
+        }
+
+        if (idx && ns->trie[idx].ch == ch)
+            return idx;
+    }
+
+    if (ns->ntrie >= ns->maxtrie) {
+        ns->maxtrie += TRIE_CHUNK;
+        ns->trie = pa_xrenew(trie_node, ns->trie, ns->maxtrie);
+    }
+
+    nidx = ns->ntrie++;
+    t = ns->trie + nidx;
+
+    memset(t, 0, sizeof(*t));
+    t->ch = ch;
+    t->sibling = idx;
+
+    if (nidx > 0) {
+        if (prev)
+            ns->trie[prev].sibling = nidx;
+        else
+            ns->trie[parent].child = nidx;
+    }
+
+    return nidx;
+}
+
+static pa_nodeset_map *trie_match(pa_nodeset *ns, const char *bin)
+{
+    trie_node *t;
+    pa_nodeset_map *best;
+    const unsigned char *p;
+    uint32_t idx;
+
+    pa_assert(ns);
+    pa_assert(bin);
+    pa_assert_se((t = ns->trie));
+
+    best = t[0].prefix;
+
+    for (idx = 0, p = (const unsigned char *)bin;  *p;  p++) {
+        for (idx = t[idx].child;  idx && t[idx].ch < *p;  idx = t[idx].sibling)
+            ;
+
+        if (!idx || t[idx].ch != *p)
+            return best;
+
+        if (t[idx].prefix)
+            best = t[idx].prefix;
+    }
+
+    return t[idx].exact ? t[idx].exact : best;
+}
+
 static int print_map(pa_hashmap *map, const char *name, char *buf, int len)
 {
 #define PRINT(fmt,args...) \
@@ -30,6 +30,14 @@
 
 #define AM_ID_INVALID   65535
 
+#define MIR_NODE_HOT_USED       (1 << 0)
+#define MIR_NODE_HOT_AVAILABLE  (1 << 1)
+#define MIR_NODE_HOT_IGNORE     (1 << 2)
+#define MIR_NODE_HOT_ROUTABLE   (1 << 3) /**< has a sink|source or a port,
+                                              or can get one by a profile
+                                              change (bluetooth) */
+#define MIR_NODE_HOT_NOZONE     255
+
 struct pa_nodeset_resdef {
     uint32_t           priority;
     struct {
@@ -38,16 +46,21 @@ struct pa_nodeset_resdef {
     }                  flags;
 };
 
+#define PA_NODESET_MAP_LAUNCHER (1 << 0) /**< binary launches other apps;
+                                              the real one is looked up
+                                              by the pid */
+
 struct pa_nodeset_map {
     const char        *name;
     mir_node_type      type;
     const char        *role;
     pa_nodeset_resdef *resdef;
+    uint32_t           flags;
 }; 
 
 struct pa_node_card {
-    uint32_t  index;
-    char     *profile;
+    uint32_t    index;
+    const char *profile;
 };
 
 struct pa_node_rset {
@@ -55,6 +68,25 @@ struct pa_node_rset {
     bool      grant;            /**< permission to play/render etc */
 };
 
+/**
+ * @brief the routing relevant fields of a node
+ *
+ * @details the hot table is a compact, index addressed copy of the
+ *          fields that the default routing checks for every candidate
+ *          device, so that the candidate selection does not need to
+ *          chase pointers into the large mir_node structures. It must
+ *          be resynced by mir_node_update_hot() whenever any of the
+ *          mirrored mir_node fields change.
+ */
+struct mir_node_hot {
+    uint16_t  type;      /**< mir_node_type */
+    uint8_t   flags;     /**< MIR_NODE_HOT_xxx */
+    uint8_t   zone;      /**< zone index or MIR_NODE_HOT_NOZONE */
+    uint8_t   privacy;   /**< mir_privacy */
+    uint8_t   location;  /**< mir_location */
+    uint16_t  channels;  /**< number of channels */
+};
+
 /**
  * @brief routing endpoint
  *
@@ -68,14 +100,16 @@ struct pa_node_rset {
  */
 struct mir_node {
     uint32_t       index;     /**< index into nodeset->idxset */
-    char          *key;       /**< hash key for discover lookups */
+    uint32_t       hotidx;    /**< index into the hot table */
+    const char    *key;       /**< hash key for discover lookups */
     mir_direction  direction; /**< mir_input | mir_output */
     mir_implement  implement; /**< mir_device | mir_stream */
     uint32_t       channels;  /**< number of channels (eg. 1=mono, 2=stereo) */
     mir_location   location;  /**< mir_internal | mir_external */
     mir_privacy    privacy;   /**< mir_public | mir_private */
     mir_node_type  type;      /**< mir_speakers | mir_headset | ...  */
-    char          *zone;      /**< zone where the node belong */
+    const char    *zone;      /**< zone where the node belong */
+    uint32_t       zoneidx;   /**< index of zone or PA_IDXSET_INVALID */
     bool           visible;   /**< internal or can appear on UI  */
     bool           available; /**< eg. is the headset connected?  */
     bool           ignore;    /**< do not consider it while routing  */
@@ -92,7 +126,16 @@ struct mir_node {
     mir_dlist      rtentries; /**< in device nodes: listhead of nodchain */
     mir_dlist      rtprilist; /**< in stream nodes: priority link (head is in
                                                                    pa_router)*/
+    mir_node_type  rtclass;   /**< in stream nodes: application class */
+    int            rtrank;    /**< in stream nodes: rank of the priority of
+                                   rtclass (index of its bucket) */
+    mir_dlist      rtzonlist; /**< in stream nodes: priority link within the
+                                   zone (head is in pa_router) */
+    uint32_t       rtend;     /**< in stream nodes: index of the node where
+                                   the stream was routed by default */
+    bool           rtdirty;   /**< in stream nodes: needs to be rerouted */
     mir_dlist      constrains;/**< listhead of constrains */
+    uint32_t       cstrslot;  /**< slot in the constrain bitmaps, if any */
     mir_vlim       vlim;      /**< volume limit */
     pa_node_rset   rset;      /**< resource set info if applies */
     uint32_t       stamp;
@@ -113,7 +156,7 @@ void pa_nodeset_delete_role(struct userdata *, const char *);
 pa_nodeset_map *pa_nodeset_get_map_by_role(struct userdata *, const char *);
 
 int pa_nodeset_add_binary(struct userdata *, const char *, mir_node_type,
-                          const char *, pa_nodeset_resdef *);
+                          const char *, pa_nodeset_resdef *, uint32_t);
 void pa_nodeset_delete_binary(struct userdata *, const char *);
 pa_nodeset_map *pa_nodeset_get_map_by_binary(struct userdata *, const char *);
 
@@ -127,6 +170,9 @@ void mir_node_destroy(struct userdata *, mir_node *);
 
 mir_node *mir_node_find_by_index(struct userdata *, uint32_t);
 
+void mir_node_update_hot(struct userdata *, mir_node *);
+const mir_node_hot *mir_node_hot_table(struct userdata *);
+
 
 int mir_node_print(mir_node *, char *, int);
 
@@ -0,0 +1,854 @@
+/*
+ * module-murphy-ivi -- PulseAudio module for providing audio routing support
+ * Copyright (c) 2012, Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St - Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ *
+ */
+#define _GNU_SOURCE
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pulsecore/pulsecore-config.h>
+
+#include <pulse/timeval.h>
+#include <pulse/rtclock.h>
+#include <pulse/xmalloc.h>
+#include <pulse/proplist.h>
+#include <pulsecore/core.h>
+#include <pulsecore/hashmap.h>
+#include <pulsecore/idxset.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/core-error.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/mutex.h>
+#include <pulsecore/log.h>
+
+#ifdef WITH_AUL
+#include <aul.h>
+#endif
+
+#include "pidcache.h"
+#include "discover.h"
+#include "list.h"
+
+#define PIDCACHE_MAX      64      /* entries */
+#define PIDCACHE_POLL     5       /* sec, for processes with no pidfd */
+
+#define ENTRY_EXE         (1 << 0)   /* exe was looked up */
+#define ENTRY_APPID       (1 << 1)   /* appid was looked up */
+#define ENTRY_PENDING     (1 << 2)   /* being looked up by the worker */
+
+typedef struct pidcache_job pidcache_job;
+
+struct pidcache_job {
+    pidcache_job    *next;
+    pid_t            pid;
+    pid_t            ppid;
+    char            *exe;
+    char            *appid;
+};
+
+typedef struct {
+    pa_thread       *thread;
+    pa_mutex        *mutex;
+    pa_cond         *cond;
+    pidcache_job    *todo;     /**< jobs for the worker, LIFO */
+    pidcache_job    *done;     /**< results for the main loop */
+    bool             quit;
+    int              pipe[2];  /**< worker wakes up the main loop */
+    pa_io_event     *doneev;
+} pidcache_worker;
+
+typedef struct {
+    mir_dlist        link;     /**< LRU order, most recent first */
+    pid_t            pid;
+    pid_t            ppid;     /**< looked up together with exe */
+    uint32_t         flags;    /**< ENTRY_xxx */
+    char            *exe;      /**< NULL if the lookup failed */
+    char            *appid;    /**< NULL if the lookup failed */
+    int              pidfd;    /**< -1 if exit is detected by polling */
+    pa_io_event     *exitev;   /**< watches pidfd */
+    pa_pidcache     *cache;
+} pidcache_entry;
+
+struct pa_pidcache {
+    struct userdata   *u;
+    pa_hashmap        *entries;  /**< pidcache_entry's by pid */
+    mir_dlist          lru;
+    uint32_t           nentry;
+    uint32_t           npoll;    /**< entries with no pidfd */
+    pa_time_event     *poll;     /**< polling fallback for exit detection */
+    pidcache_worker   *worker;   /**< in asynchronous mode only */
+    pidcache_job      *resolved; /**< result being delivered with no entry */
+    pa_pidcache_stats  stats;
+};
+
+static pidcache_entry *entry_get(pa_pidcache *, pid_t);
+static void entry_destroy(pa_pidcache *, pidcache_entry *);
+static void watch_exit(pa_pidcache *, pidcache_entry *);
+
+static void exit_cb(pa_mainloop_api *, pa_io_event *, int,
+                    pa_io_event_flags_t, void *);
+static void poll_cb(pa_mainloop_api *, pa_time_event *,
+                    const struct timeval *, void *);
+static void poll_arm(pa_pidcache *);
+
+static pidcache_worker *worker_create(pa_pidcache *);
+static void worker_destroy(pa_pidcache *, pidcache_worker *);
+static void worker_request(pa_pidcache *, pidcache_entry *);
+static void worker_thread(void *);
+static void done_cb(pa_mainloop_api *, pa_io_event *, int,
+                    pa_io_event_flags_t, void *);
+
+static pid_t get_ppid(pid_t);
+static int resolve_exe(pid_t, pid_t *, char *, size_t);
+static int pid2exe(pid_t, pid_t, char *, size_t);
+static char *pid2appid(pid_t, char *, size_t);
+
+
+pa_pidcache *pa_pidcache_init(struct userdata *u, bool async)
+{
+    pa_pidcache *cache;
+
+    pa_assert(u);
+
+    cache = pa_xnew0(pa_pidcache, 1);
+    cache->u = u;
+    cache->entries = pa_hashmap_new(pa_idxset_trivial_hash_func,
+                                    pa_idxset_trivial_compare_func);
+    MIR_DLIST_INIT(cache->lru);
+
+    if (async && !(cache->worker = worker_create(cache)))
+        pa_log("pidcache: falling back to synchronous lookups");
+
+    return cache;
+}
+
+void pa_pidcache_done(struct userdata *u)
+{
+    pa_pidcache *cache;
+    pa_mainloop_api *mainloop;
+    pidcache_entry *e, *n;
+
+    if (u && (cache = u->pidcache)) {
+        pa_assert_se((mainloop = u->core->mainloop));
+
+        if (cache->worker)
+            worker_destroy(cache, cache->worker);
+
+        MIR_DLIST_FOR_EACH_SAFE(pidcache_entry, link, e,n, &cache->lru) {
+            entry_destroy(cache, e);
+        }
+
+        if (cache->poll)
+            mainloop->time_free(cache->poll);
+
+        pa_log_debug("pidcache: %u hits, %u misses, %u exited, %u evicted",
+                     cache->stats.nhit, cache->stats.nmiss,
+                     cache->stats.nexit, cache->stats.nevict);
+
+        pa_hashmap_free(cache->entries);
+        pa_xfree(cache);
+
+        u->pidcache = NULL;
+    }
+}
+
+const char *pa_pidcache_get_exe(struct userdata *u, pid_t pid, bool async)
+{
+    pa_pidcache *cache;
+    pidcache_entry *e;
+    char buf[4096];
+
+    pa_assert(u);
+    pa_assert_se((cache = u->pidcache));
+
+    if (cache->resolved && cache->resolved->pid == pid)
+        return cache->resolved->exe;
+
+    if (!(e = entry_get(cache, pid)))
+        return NULL;
+
+    if ((e->flags & ENTRY_EXE))
+        cache->stats.nhit++;
+    else if (async && cache->worker)
+        worker_request(cache, e);
+    else {
+        cache->stats.nmiss++;
+        e->flags |= ENTRY_EXE;
+
+        if (resolve_exe(pid, &e->ppid, buf, sizeof(buf)) == 0)
+            e->exe = pa_xstrdup(buf);
+    }
+
+    return e->exe;
+}
+
+const char *pa_pidcache_get_appid(struct userdata *u, pid_t pid, bool async)
+{
+    pa_pidcache *cache;
+    pidcache_entry *e;
+    char buf[PATH_MAX];
+
+    pa_assert(u);
+    pa_assert_se((cache = u->pidcache));
+
+    if (cache->resolved && cache->resolved->pid == pid)
+        return cache->resolved->appid;
+
+    if (!(e = entry_get(cache, pid)))
+        return NULL;
+
+    if ((e->flags & ENTRY_APPID))
+        cache->stats.nhit++;
+    else if (async && cache->worker)
+        worker_request(cache, e);
+    else {
+        cache->stats.nmiss++;
+        e->flags |= ENTRY_APPID;
+
+        if (pid2appid(pid, buf, sizeof(buf)))
+            e->appid = pa_xstrdup(buf);
+    }
+
+    return e->appid;
+}
+
+bool pa_pidcache_is_pending(struct userdata *u, pid_t pid)
+{
+    pa_pidcache *cache;
+    pidcache_entry *e;
+
+    pa_assert(u);
+    pa_assert_se((cache = u->pidcache));
+
+    if (pid < 2)
+        return false;
+
+    if (!(e = pa_hashmap_get(cache->entries, PA_UINT32_TO_PTR(pid))))
+        return false;
+
+    return (e->flags & ENTRY_PENDING) ? true : false;
+}
+
+void pa_pidcache_publish_stats(struct userdata *u, pa_proplist *pl)
+{
+    pa_pidcache *cache;
+
+    pa_assert(u);
+    pa_assert(pl);
+
+    if (!(cache = u->pidcache))
+        return;
+
+    pa_proplist_setf(pl, PA_PROP_STATS ".pidcache.hits", "%u",
+                     cache->stats.nhit);
+    pa_proplist_setf(pl, PA_PROP_STATS ".pidcache.misses", "%u",
+                     cache->stats.nmiss);
+    pa_proplist_setf(pl, PA_PROP_STATS ".pidcache.exited", "%u",
+                     cache->stats.nexit);
+    pa_proplist_setf(pl, PA_PROP_STATS ".pidcache.evicted", "%u",
+                     cache->stats.nevict);
+}
+
+
+static pidcache_entry *entry_get(pa_pidcache *cache, pid_t pid)
+{
+    pidcache_entry *e;
+
+    pa_assert(cache);
+
+    if (pid < 2)
+        return NULL;
+
+    if ((e = pa_hashmap_get(cache->entries, PA_UINT32_TO_PTR(pid)))) {
+        /* move to the front of the LRU list */
+        MIR_DLIST_UNLINK(pidcache_entry, link, e);
+        MIR_DLIST_PREPEND(pidcache_entry, link, e, &cache->lru);
+        return e;
+    }
+
+    if (cache->nentry >= PIDCACHE_MAX) {
+        e = MIR_LIST_RELOCATE(pidcache_entry, link, cache->lru.prev);
+        entry_destroy(cache, e);
+        cache->stats.nevict++;
+    }
+
+    e = pa_xnew0(pidcache_entry, 1);
+    e->pid = pid;
+    e->pidfd = -1;
+    e->cache = cache;
+
+    MIR_DLIST_PREPEND(pidcache_entry, link, e, &cache->lru);
+    pa_hashmap_put(cache->entries, PA_UINT32_TO_PTR(pid), e);
+    cache->nentry++;
+
+    watch_exit(cache, e);
+
+    return e;
+}
+
+static void entry_destroy(pa_pidcache *cache, pidcache_entry *e)
+{
+    pa_mainloop_api *mainloop;
+
+    pa_assert(cache);
+    pa_assert(e);
+    pa_assert_se((mainloop = cache->u->core->mainloop));
+
+    pa_hashmap_remove(cache->entries, PA_UINT32_TO_PTR(e->pid));
+    MIR_DLIST_UNLINK(pidcache_entry, link, e);
+    cache->nentry--;
+
+    if (e->exitev)
+        mainloop->io_free(e->exitev);
+
+    if (e->pidfd >= 0)
+        close(e->pidfd);
+    else
+        cache->npoll--;
+
+    pa_xfree(e->exe);
+    pa_xfree(e->appid);
+    pa_xfree(e);
+}
+
+static void watch_exit(pa_pidcache *cache, pidcache_entry *e)
+{
+    pa_mainloop_api *mainloop;
+
+    pa_assert(cache);
+    pa_assert(e);
+    pa_assert_se((mainloop = cache->u->core->mainloop));
+
+#ifdef SYS_pidfd_open
+    /* a pidfd becomes readable when the process exits */
+    if ((e->pidfd = (int)syscall(SYS_pidfd_open, e->pid, 0)) >= 0) {
+        e->exitev = mainloop->io_new(mainloop, e->pidfd, PA_IO_EVENT_INPUT,
+                                     exit_cb, e);
+        return;
+    }
+#endif
+
+    e->pidfd = -1;
+    cache->npoll++;
+
+    poll_arm(cache);
+}
+
+static void exit_cb(pa_mainloop_api *m, pa_io_event *ev, int fd,
+                    pa_io_event_flags_t events, void *userdata)
+{
+    pidcache_entry *e = userdata;
+    pa_pidcache *cache;
+
+    (void)m;
+    (void)ev;
+    (void)fd;
+    (void)events;
+
+    pa_assert(e);
+    pa_assert_se((cache = e->cache));
+
+    pa_log_debug("pidcache: process %u exited", e->pid);
+
+    cache->stats.nexit++;
+    entry_destroy(cache, e);
+}
+
+static void poll_cb(pa_mainloop_api *m, pa_time_event *ev,
+                    const struct timeval *t, void *userdata)
+{
+    pa_pidcache *cache = userdata;
+    pidcache_entry *e, *n;
+
+    (void)t;
+
+    pa_assert(cache);
+
+    m->time_restart(ev, NULL);
+
+    MIR_DLIST_FOR_EACH_SAFE(pidcache_entry, link, e,n, &cache->lru) {
+        if (e->pidfd < 0 && kill(e->pid, 0) < 0 && errno == ESRCH) {
+            pa_log_debug("pidcache: process %u is gone", e->pid);
+            cache->stats.nexit++;
+            entry_destroy(cache, e);
+        }
+    }
+
+    poll_arm(cache);
+}
+
+static void poll_arm(pa_pidcache *cache)
+{
+    pa_core *core;
+    pa_usec_t when;
+
+    pa_assert(cache);
+    pa_assert_se((core = cache->u->core));
+
+    if (!cache->npoll)
+        return;
+
+    when = pa_rtclock_now() + (pa_usec_t)PIDCACHE_POLL * PA_USEC_PER_SEC;
+
+    if (cache->poll)
+        pa_core_rttime_restart(core, cache->poll, when);
+    else
+        cache->poll = pa_core_rttime_new(core, when, poll_cb, cache);
+}
+
+static pidcache_worker *worker_create(pa_pidcache *cache)
+{
+    pa_mainloop_api *mainloop;
+    pidcache_worker *w;
+
+    pa_assert(cache);
+    pa_assert_se((mainloop = cache->u->core->mainloop));
+
+    w = pa_xnew0(pidcache_worker, 1);
+
+    if (pipe(w->pipe) < 0) {
+        pa_log("pidcache: can't create pipe: %s", pa_cstrerror(errno));
+        pa_xfree(w);
+        return NULL;
+    }
+
+    pa_make_fd_nonblock(w->pipe[0]);
+    pa_make_fd_nonblock(w->pipe[1]);
+    pa_make_fd_cloexec(w->pipe[0]);
+    pa_make_fd_cloexec(w->pipe[1]);
+
+    w->mutex  = pa_mutex_new(false, false);
+    w->cond   = pa_cond_new();
+    w->doneev = mainloop->io_new(mainloop, w->pipe[0], PA_IO_EVENT_INPUT,
+                                 done_cb, cache);
+
+    if (!(w->thread = pa_thread_new("mir-pidcache", worker_thread, w))) {
+        pa_log("pidcache: can't create worker thread");
+        mainloop->io_free(w->doneev);
+        pa_cond_free(w->cond);
+        pa_mutex_free(w->mutex);
+        close(w->pipe[0]);
+        close(w->pipe[1]);
+        pa_xfree(w);
+        return NULL;
+    }
+
+    return w;
+}
+
+static void worker_destroy(pa_pidcache *cache, pidcache_worker *w)
+{
+    pa_mainloop_api *mainloop;
+    pidcache_job *job, *next;
+
+    pa_assert(cache);
+    pa_assert(w);
+    pa_assert_se((mainloop = cache->u->core->mainloop));
+
+    pa_mutex_lock(w->mutex);
+    w->quit = true;
+    pa_cond_signal(w->cond, 0);
+    pa_mutex_unlock(w->mutex);
+
+    pa_thread_free(w->thread);
+
+    mainloop->io_free(w->doneev);
+    close(w->pipe[0]);
+    close(w->pipe[1]);
+
+    for (job = w->todo;  job;  job = next) {
+        next = job->next;
+        pa_xfree(job);
+    }
+
+    for (job = w->done;  job;  job = next) {
+        next = job->next;
+        pa_xfree(job->exe);
+        pa_xfree(job->appid);
+        pa_xfree(job);
+    }
+
+    pa_cond_free(w->cond);
+    pa_mutex_free(w->mutex);
+    pa_xfree(w);
+
+    cache->worker = NULL;
+}
+
+static void worker_request(pa_pidcache *cache, pidcache_entry *e)
+{
+    pidcache_worker *w;
+    pidcache_job *job;
+
+    pa_assert(cache);
+    pa_assert(e);
+    pa_assert_se((w = cache->worker));
+
+    if ((e->flags & ENTRY_PENDING))
+        return;
+
+    e->flags |= ENTRY_PENDING;
+    cache->stats.nmiss++;
+
+    job = pa_xnew0(pidcache_job, 1);
+    job->pid = e->pid;
+
+    pa_mutex_lock(w->mutex);
+    job->next = w->todo;
+    w->todo = job;
+    pa_cond_signal(w->cond, 0);
+    pa_mutex_unlock(w->mutex);
+}
+
+static void worker_thread(void *userdata)
+{
+    pidcache_worker *w = userdata;
+    pidcache_job *job;
+    char exe[4096];
+    char appid[PATH_MAX];
+    ssize_t n;
+
+    pa_assert(w);
+
+    pa_mutex_lock(w->mutex);
+
+    for (;;) {
+        while (!w->todo && !w->quit)
+            pa_cond_wait(w->cond, w->mutex);
+
+        if (w->quit)
+            break;
+
+        job = w->todo;
+        w->todo = job->next;
+
+        pa_mutex_unlock(w->mutex);
+
+        /* the blocking /proc and AUL access happens here */
+        if (resolve_exe(job->pid, &job->ppid, exe, sizeof(exe)) == 0)
+            job->exe = pa_xstrdup(exe);
+
+        if (pid2appid(job->pid, appid, sizeof(appid)))
+            job->appid = pa_xstrdup(appid);
+
+        pa_mutex_lock(w->mutex);
+
+        job->next = w->done;
+        w->done = job;
+
+        /* a full pipe has a wakeup pending already */
+        n = write(w->pipe[1], "", 1);
+        (void)n;
+    }
+
+    pa_mutex_unlock(w->mutex);
+}
+
+static void done_cb(pa_mainloop_api *m, pa_io_event *ev, int fd,
+                    pa_io_event_flags_t events, void *userdata)
+{
+    pa_pidcache *cache = userdata;
+    pidcache_worker *w;
+    pidcache_job *jobs, *job;
+    pidcache_entry *e;
+    char buf[64];
+    pid_t pid;
+
+    (void)m;
+    (void)ev;
+    (void)events;
+
+    pa_assert(cache);
+    pa_assert_se((w = cache->worker));
+
+    while (read(fd, buf, sizeof(buf)) > 0)
+        ;
+
+    pa_mutex_lock(w->mutex);
+    jobs = w->done;
+    w->done = NULL;
+    pa_mutex_unlock(w->mutex);
+
+    while ((job = jobs)) {
+        jobs = job->next;
+        pid = job->pid;
+
+        pa_log_debug("pidcache: identity of process %u resolved", pid);
+
+        if ((e = pa_hashmap_get(cache->entries, PA_UINT32_TO_PTR(pid)))) {
+            pa_xfree(e->exe);
+            pa_xfree(e->appid);
+
+            e->flags &= ~ENTRY_PENDING;
+            e->flags |= ENTRY_EXE | ENTRY_APPID;
+            e->ppid   = job->ppid;
+            e->exe    = job->exe;
+            e->appid  = job->appid;
+
+            pa_discover_process_resolved(cache->u, pid);
+        }
+        else {
+            /*
+             * the entry was evicted or its process exited meanwhile;
+             * hand the results to the reclassification without making
+             * a new entry that would evict a live one
+             */
+            cache->resolved = job;
+            pa_discover_process_resolved(cache->u, pid);
+            cache->resolved = NULL;
+
+            pa_xfree(job->exe);
+            pa_xfree(job->appid);
+        }
+
+        pa_xfree(job);
+    }
+}
+
+static int resolve_exe(pid_t pid, pid_t *ppid_ret, char *buf, size_t len)
+{
+    pa_assert(ppid_ret);
+
+    *ppid_ret = 0;
+
+#ifdef WITH_AUL
+    if (aul_app_get_appid_bypid(pid, buf, len) >= 0)
+        return 0;
+#endif
+
+    *ppid_ret = get_ppid(pid);
+
+    return pid2exe(pid, *ppid_ret, buf, len);
+}
+
+
+static char *get_tag(pid_t pid, const char *tag, char *buf, size_t size)
+{
+    char path[PATH_MAX];
+    char data[8192], *p, *q;
+    int  fd, n;
+    size_t tlen;
+
+    fd = -1;
+    snprintf(path, sizeof(path), "/proc/%u/status", pid);
+
+    if ((fd = open(path, O_RDONLY)) < 0) {
+    fail:
+        if (fd >= 0)
+            close(fd);
+        return NULL;
+    }
+
+    if ((n = read(fd, data, sizeof(data) - 1)) <= 0)
+        goto fail;
+    else
+        data[sizeof(data)-1] = '\0';
+
+    close(fd);
+    fd = -1;
+    tlen = strlen(tag);
+
+    p = data;
+    while (*p) {
+        if (*p != '\n' && p != data) {
+            while (*p && *p != '\n')
+                p++;
+        }
+
+        if (*p == '\n')
+            p++;
+        else
+            if (p != data)
+                goto fail;
+
+        if (!strncmp(p, tag, tlen) && p[tlen] == ':') {
+            p += tlen + 1;
+            while (*p == ' ' || *p == '\t')
+                p++;
+
+            q = buf;
+            while (*p != '\n' && *p && size > 1)
+                *q++ = *p++;
+            *q = '\0';
+
+            return buf;
+        }
+        else
+            p++;
+    }
+
+    goto fail;
+}
+
+
+static pid_t get_ppid(pid_t pid)
+{
+    char  buf[32], *end;
+    pid_t ppid;
+
+    if (get_tag(pid, "PPid", buf, sizeof(buf)) != NULL) {
+        ppid = strtol(buf, &end, 10);
+
+        if (end && !*end)
+            return ppid;
+    }
+
+    return 0;
+}
+
+
+static int pid2exe(pid_t pid, pid_t ppid, char *buf, size_t len)
+{
+    FILE *f;
+    char path[PATH_MAX];
+    char *p, *q;
+    int st = -1;
+
+    if (buf && len > 0) {
+        snprintf(path, sizeof(path), "/proc/%u/cmdline", ppid);
+
+        if ((f = fopen(path, "r"))) {
+            if (fgets(buf, (int)len-1, f)) {
+                if ((p = strchr(buf, ' ')))
+                    *p = '\0';
+                else if ((p = strchr(buf, '\n')))
+                    *p = '\0';
+                else
+                    p = buf + strlen(buf);
+
+                if ((q = strrchr(buf, '/')))
+                    memmove(buf, q+1, (size_t)(p-q)); 
+
+                st = 0;
+            }
+            fclose(f);
+        }
+    }
+
+    if (st < 0)
+        pa_log("pid2exe(%u) failed", pid);
+    else
+        pa_log_debug("pid2exe(%u) => exe %s", pid, buf);
+
+    return st;
+}
+
+
+static char *get_binary(pid_t pid, char *buf, size_t size)
+{
+    char    path[128];
+    ssize_t len;
+
+    snprintf(path, sizeof(path), "/proc/%u/exe", pid);
+    if ((len = readlink(path, buf, size - 1)) > 0) {
+        buf[len] = '\0';
+        return buf;
+    }
+    else
+        return NULL;
+}
+
+
+static char *strprev(char *point, char c, char *base)
+{
+    while (point > base && *point != c)
+        point--;
+
+    if (*point == c)
+        return point;
+    else
+        return NULL;
+}
+
+
+static char *pid2appid(pid_t pid, char *buf, size_t size)
+{
+    char binary[PATH_MAX];
+    char path[PATH_MAX], *dir, *p, *base;
+    unsigned int len;
+
+    if (!pid || !get_binary(pid, binary, sizeof(binary)))
+        return NULL;
+
+    strncpy(path, binary, sizeof(path) - 1);
+    path[sizeof(path) - 1] = '\0';
+
+    /* fetch basename */
+    if ((p = strrchr(path, '/')) == NULL || p == path) {
+        strncpy(buf, binary, size - 1);
+        buf[size - 1] = '\0';
+        return buf;
+    }
+
+    base = p-- + 1;
+
+    /* fetch ../bin/<basename> */
+    if ((p = strprev(p, '/', path)) == NULL || p == path)
+        goto return_base;
+
+    if (strncmp(p + 1, "bin/", 4) != 0)
+        goto return_base;
+    else
+        p--;
+
+    /* fetch dir name above bin */
+    if ((dir = strprev(p, '/', path)) == NULL || dir == path)
+        goto return_base;
+
+    len = (size_t)(p - dir);
+
+    /* fetch 'apps' dir */
+    p = dir - 1;
+
+    if ((p = strprev(p, '/', path)) == NULL)
+        goto return_base;
+
+    if (strncmp(p + 1, "apps/", 5) != 0)
+        goto return_base;
+
+    if (len + 1 <= size) {
+        strncpy(buf, dir + 1, len);
+        buf[len] = '\0';
+
+        return buf;
+    }
+
+ return_base:
+    strncpy(buf, base, size - 1);
+    buf[size - 1] = '\0';
+    return buf;
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
@@ -0,0 +1,52 @@
+/*
+ * module-murphy-ivi -- PulseAudio module for providing audio routing support
+ * Copyright (c) 2012, Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St - Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ *
+ */
+#ifndef foomirpidcachefoo
+#define foomirpidcachefoo
+
+#include <sys/types.h>
+
+#include "userdata.h"
+
+typedef struct {
+    uint32_t   nhit;         /**< lookups served from the cache */
+    uint32_t   nmiss;        /**< lookups that needed /proc access */
+    uint32_t   nexit;        /**< entries dropped as their process exited */
+    uint32_t   nevict;       /**< entries dropped to stay in the bounds */
+} pa_pidcache_stats;
+
+pa_pidcache *pa_pidcache_init(struct userdata *, bool);
+void pa_pidcache_done(struct userdata *);
+
+const char *pa_pidcache_get_exe(struct userdata *, pid_t, bool);
+const char *pa_pidcache_get_appid(struct userdata *, pid_t, bool);
+bool pa_pidcache_is_pending(struct userdata *, pid_t);
+
+void pa_pidcache_publish_stats(struct userdata *, pa_proplist *);
+
+#endif  /* foomirpidcachefoo */
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
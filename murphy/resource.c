@@ -32,6 +32,7 @@
 #include "resource.h"
 #include "node.h"
 #include "stream-state.h"
+#include "fader.h"
 
 
 struct pa_resource {
@@ -957,6 +958,10 @@ static void enforce_policy(struct userdata *u,
     pa_assert_se((policy = rset->policy[type]));
 
     grant = rset->grant[type];
+
+    if (node->rset.grant != grant)
+        pa_fader_mark_node_dirty(u, node, false);
+
     node->rset.grant = grant;
 
 
@@ -25,7 +25,9 @@
 #include <pulsecore/pulsecore-config.h>
 
 #include <pulse/proplist.h>
+#include <pulse/rtclock.h>
 #include <pulsecore/module.h>
+#include <pulsecore/sink-input.h>
 
 #include "router.h"
 #include "zone.h"
@@ -37,35 +39,101 @@
 #include "utils.h"
 #include "classify.h"
 #include "audiomgr.h"
+#include "scripting.h"
+#include "scheduler.h"
+#include "slab.h"
 
 static void rtgroup_destroy(struct userdata *, mir_rtgroup *);
 static int rtgroup_print(mir_rtgroup *, char *, int);
 static void rtgroup_update_module_property(struct userdata *, mir_direction,
                                            mir_rtgroup *);
+static void rtgroup_property_changed(struct userdata *, mir_rtgroup *);
+static bool update_rtgroup_properties(struct userdata *, mir_direction,
+                                      pa_hashmap *);
 
+static void add_to_rtgroups(struct userdata *, mir_direction, pa_hashmap *,
+                            mir_node *);
 static void add_rtentry(struct userdata *, mir_direction, mir_rtgroup *,
                         mir_node *);
 static void remove_rtentry(struct userdata *, mir_rtentry *);
+static size_t rtgroup_find_slot(struct userdata *, mir_rtgroup *, mir_node *,
+                                double);
 
 static void make_explicit_routes(struct userdata *, uint32_t);
+static bool explicitly_routed(pa_router *, mir_node *);
+static bool stream_is_on_device(struct userdata *, mir_node *, mir_node *);
 static mir_node *find_default_route(struct userdata *, mir_node *, uint32_t);
+static mir_node *select_default_route(struct userdata *, mir_node *,
+                                      mir_rtgroup *, uint32_t);
+static bool reuse_default_route(struct userdata *, mir_node *, uint32_t,
+                                mir_node **);
+static mir_rtgroup *get_stream_rtgroup(struct userdata *, mir_node *,
+                                       mir_zone **);
+static void mark_constrain_dirty(struct userdata *, mir_node *);
+static bool get_dirty_zones(struct userdata *, uint32_t *);
+static bool zone_is_isolated(struct userdata *, uint32_t);
+static void keep_zone_routes(struct userdata *, uint32_t, uint32_t);
+static void sync_shared_devices(struct userdata *, uint32_t, uint32_t);
+static bool update_stream_route(struct userdata *, mir_node *, uint32_t);
+static void plan_add(mir_rtplan *, mir_node *, mir_node *, uint32_t);
+static void plan_apply(struct userdata *, uint32_t);
+static void plan_store(struct userdata *, uint32_t);
+static bool plan_has_target(mir_rtplan *, uint32_t);
+static void plan_free(mir_rtplan *);
+static void clear_dirty(struct userdata *);
+static bool verify_routing(struct userdata *);
 static void implement_preroute(struct userdata *, mir_node *, mir_node *,
                                uint32_t);
 static void implement_default_route(struct userdata *, mir_node *, mir_node *,
                                     uint32_t);
 
 static int uint32_cmp(uint32_t, uint32_t);
+static uint32_t default_sort_priority(mir_node *);
+static uint32_t phone_sort_priority(mir_node *);
 
-static int node_priority(struct userdata *, mir_node *);
+static int class_rank(pa_router *, mir_node_type);
+static void update_class_ranks(pa_router *);
+static void link_stream_node(pa_router *, mir_node *);
+static void rebucket_stream_nodes(pa_router *);
+
+static void prilist_init(mir_rtprilist *);
+static void prilist_add(mir_rtprilist *, mir_dlist *, int);
 
 static int volume_class(mir_node *);
 
 static int print_routing_table(pa_hashmap *, const char *, char *, int);
 
-pa_router *pa_router_init(struct userdata *u)
+static bool ongoing_routing;
+
+#if MRP_ZONE_MAX > 32
+#error "zone masks do not fit to 32 bits"
+#endif
+
+#define ZONE_BIT(z)      ((uint32_t)1 << (z))
+#define ZONE_MASK_ALL    (~(uint32_t)0)
+
+/* hot table flags of a device that can be selected for a default route */
+#define HOT_CANDIDATE_MASK  (MIR_NODE_HOT_IGNORE | MIR_NODE_HOT_AVAILABLE | \
+                             MIR_NODE_HOT_ROUTABLE)
+#define HOT_CANDIDATE       (MIR_NODE_HOT_AVAILABLE | MIR_NODE_HOT_ROUTABLE)
+
+/*
+ * from the highest priority downwards. 'break' leaves only the bucket at
+ * hand; the _UNTIL form stops the whole walk once 'done' becomes true.
+ */
+#define PRILIST_FOR_EACH_BACKWARD(member, pos, prio, pl)                \
+    PRILIST_FOR_EACH_BACKWARD_UNTIL(member, pos, prio, pl, false)
+
+#define PRILIST_FOR_EACH_BACKWARD_UNTIL(member, pos, prio, pl, done)    \
+    for (prio = (pl)->nbucket - 1;  prio >= 0 && !(done);  prio--)      \
+        MIR_DLIST_FOR_EACH_BACKWARD(mir_node, member, pos,              \
+                                    &(pl)->buckets[prio])
+
+pa_router *pa_router_init(struct userdata *u, bool verify, bool batch_accept)
 {
     size_t num_classes = mir_application_class_end;
     pa_router *router = pa_xnew0(pa_router, 1);
+    int i;
     
     router->rtgroups.input  = pa_hashmap_new(pa_idxset_string_hash_func,
                                             pa_idxset_string_compare_func);
@@ -75,9 +143,17 @@ pa_router *pa_router_init(struct userdata *u)
     router->maplen = num_classes;
 
     router->priormap = pa_xnew0(int, num_classes);
+    router->rankmap  = pa_xnew0(int, num_classes);
 
-    MIR_DLIST_INIT(router->nodlist);
+    prilist_init(&router->prilist);
     MIR_DLIST_INIT(router->connlist);
+
+    for (i = 0;  i < MRP_ZONE_MAX;  i++)
+        prilist_init(&router->shards[i].prilist);
+
+    router->dirty.all = true;
+    router->verify = verify;
+    router->batchacc = batch_accept;
     
     return router;
 }
@@ -90,16 +166,23 @@ void pa_router_done(struct userdata *u)
     void           *state;
     mir_rtgroup    *rtg;
     mir_rtgroup   **map;
-    int             i;
+    int             i, p;
 
     if (u && (router = u->router)) {
-        MIR_DLIST_FOR_EACH_SAFE(mir_node, rtprilist, e,n, &router->nodlist) {
-            MIR_DLIST_UNLINK(mir_node, rtprilist, e);
+        for (p = 0;  p < router->prilist.nbucket;  p++) {
+            MIR_DLIST_FOR_EACH_SAFE(mir_node, rtprilist, e,n,
+                                    &router->prilist.buckets[p])
+            {
+                MIR_DLIST_UNLINK(mir_node, rtprilist, e);
+                MIR_DLIST_UNLINK(mir_node, rtzonlist, e);
+            }
         }
 
+        pa_xfree(router->prilist.buckets);
+
         MIR_DLIST_FOR_EACH_SAFE(mir_connection,link, conn,c,&router->connlist){
             MIR_DLIST_UNLINK(mir_connection, link, conn);
-            pa_xfree(conn);
+            pa_slab_free(u, PA_SLAB_CONNECTION, conn);
         }
 
         PA_HASHMAP_FOREACH(rtg, router->rtgroups.input, state) {
@@ -121,7 +204,16 @@ void pa_router_done(struct userdata *u)
                 pa_xfree(map);
         }
 
+        for (i = 0;  i < MRP_ZONE_MAX;  i++) {
+            pa_xfree(router->shards[i].prilist.buckets);
+            plan_free(&router->shards[i].plan);
+        }
+
+        plan_free(&router->next);
+        plan_free(&router->diff);
+
         pa_xfree(router->priormap);
+        pa_xfree(router->rankmap);
         pa_xfree(router);
 
         u->router = NULL;
@@ -144,6 +236,8 @@ void mir_router_assign_class_priority(struct userdata *u,
         pa_log_debug("assigning priority %d to class '%s'",
                      pri, mir_node_type_str(class));
         priormap[class] = pri;
+        rebucket_stream_nodes(router);
+        router->dirty.all = true;
     }
 }
 
@@ -152,7 +246,8 @@ mir_rtgroup *mir_router_create_rtgroup(struct userdata      *u,
                                        mir_direction         type,
                                        const char           *name,
                                        mir_rtgroup_accept_t  accept,
-                                       mir_rtgroup_compare_t compare)
+                                       mir_rtgroup_compare_t compare,
+                                       mir_rtgroup_sortkey_t sortkey)
 {
     pa_router   *router;
     pa_hashmap  *table;
@@ -162,7 +257,7 @@ mir_rtgroup *mir_router_create_rtgroup(struct userdata      *u,
     pa_assert(type == mir_input || type == mir_output);
     pa_assert(name);
     pa_assert(accept);
-    pa_assert(compare);
+    pa_assert(compare || sortkey);
     pa_assert_se((router = u->router));
 
     if (type == mir_input)
@@ -176,7 +271,7 @@ mir_rtgroup *mir_router_create_rtgroup(struct userdata      *u,
     rtg->name    = pa_xstrdup(name);
     rtg->accept  = accept;
     rtg->compare = compare;
-    MIR_DLIST_INIT(rtg->entries);
+    rtg->sortkey = sortkey;
 
     if (pa_hashmap_put(table, rtg->name, rtg) < 0) {
         pa_xfree(rtg->name);
@@ -184,6 +279,8 @@ mir_rtgroup *mir_router_create_rtgroup(struct userdata      *u,
         return NULL;
     }
 
+    router->dirty.all = true;
+
     pa_log_debug("%s routing group '%s' created",
                  mir_direction_str(type), name);
 
@@ -215,6 +312,7 @@ void mir_router_destroy_rtgroup(struct userdata *u,
     }
     else {
         rtgroup_destroy(u, rtg);
+        router->dirty.all = true;
         pa_log_debug("routing group '%s' destroyed", name);
     }
 }
@@ -271,6 +369,7 @@ bool mir_router_assign_class_to_rtgroup(struct userdata *u,
     }
 
     zonemap[class] = rtg;
+    router->dirty.zones[zone] = true;
 
     if ((z = pa_zoneset_get_zone_by_index(u, zone))) {
         pa_log_debug("class '%s'@'%s' assigned to %s routing group '%s'",
@@ -289,21 +388,17 @@ bool mir_router_assign_class_to_rtgroup(struct userdata *u,
 void mir_router_register_node(struct userdata *u, mir_node *node)
 {
     pa_router   *router;
-    mir_rtgroup *rtg;
-    void        *state;
-    int          priority;
-    mir_node    *before;
 
     pa_assert(u);
     pa_assert(node);
     pa_assert_se((router = u->router));
+
+    node->rtclass = pa_classify_guess_application_class(node);
+    node->rtrank  = class_rank(router, node->rtclass);
     
     if (node->direction == mir_output) {
-        if (node->implement == mir_device) {
-            PA_HASHMAP_FOREACH(rtg, router->rtgroups.output, state) {
-                add_rtentry(u, mir_output, rtg, node);
-            }
-        }
+        if (node->implement == mir_device)
+            add_to_rtgroups(u, mir_output, router->rtgroups.output, node);
         return;
     }
 
@@ -316,25 +411,15 @@ void mir_router_register_node(struct userdata *u, mir_node *node)
 #endif
 
         if (node->implement == mir_device) {
-            PA_HASHMAP_FOREACH(rtg, router->rtgroups.input, state) {
-                add_rtentry(u, mir_input, rtg, node);
-            }
+            add_to_rtgroups(u, mir_input, router->rtgroups.input, node);
 
             if (!pa_classify_loopback_stream(node))
                 return;
         }
 
-        priority = node_priority(u, node);
-            
-        MIR_DLIST_FOR_EACH(mir_node, rtprilist, before, &router->nodlist) {
-            if (priority < node_priority(u, before)) {
-                MIR_DLIST_INSERT_BEFORE(mir_node, rtprilist, node,
-                                        &before->rtprilist);
-                return;
-            }
-        }
-            
-        MIR_DLIST_APPEND(mir_node, rtprilist, node, &router->nodlist);
+        node->rtdirty = true;
+
+        link_stream_node(router, node);
 
         return;
     }
@@ -344,6 +429,7 @@ void mir_router_unregister_node(struct userdata *u, mir_node *node)
 {
     pa_router *router;
     mir_rtentry *rte, *n;
+    mir_node *end;
     
     pa_assert(u);
     pa_assert(node);
@@ -353,7 +439,15 @@ void mir_router_unregister_node(struct userdata *u, mir_node *node)
         remove_rtentry(u, rte);
     }
 
+    /* the device this stream was holding might have been blocking others */
+    if (node->implement == mir_stream &&
+        (end = mir_node_find_by_index(u, node->rtend)))
+    {
+        mark_constrain_dirty(u, end);
+    }
+
     MIR_DLIST_UNLINK(mir_node, rtprilist, node);
+    MIR_DLIST_UNLINK(mir_node, rtzonlist, node);
 }
 
 mir_connection *mir_router_add_explicit_route(struct userdata *u,
@@ -369,7 +463,7 @@ mir_connection *mir_router_add_explicit_route(struct userdata *u,
     pa_assert(to);
     pa_assert_se((router = u->router));
 
-    conn = pa_xnew0(mir_connection, 1);
+    conn = pa_slab_alloc(u, PA_SLAB_CONNECTION);
     MIR_DLIST_INIT(conn->link);
     conn->amid = amid;
     conn->from = from->index;
@@ -414,7 +508,7 @@ void mir_router_remove_explicit_route(struct userdata *u, mir_connection *conn)
         }
     }
 
-    pa_xfree(conn);
+    pa_slab_free(u, PA_SLAB_CONNECTION, conn);
 }
 
 
@@ -441,70 +535,124 @@ int mir_router_print_rtgroups(struct userdata *u, char *buf, int len)
     return p - buf;
 }
 
+void mir_router_update_module_properties(struct userdata *u)
+{
+    pa_router *router;
+    pa_module *module;
+    bool       changed;
+    char       gen[16];
+
+    pa_assert(u);
+    pa_assert_se((router = u->router));
+    pa_assert_se((module = u->module));
+
+    changed  = update_rtgroup_properties(u, mir_input,
+                                         router->rtgroups.input);
+    changed |= update_rtgroup_properties(u, mir_output,
+                                         router->rtgroups.output);
+
+    if (changed) {
+        snprintf(gen, sizeof(gen), "%u", ++router->tblgen);
+        pa_proplist_sets(module->proplist, PA_PROP_ROUTING_TABLE ".generation",
+                         gen);
+
+        pa_log_debug("routing tables published (generation %u)",
+                     router->tblgen);
+    }
+}
+
 
 mir_node *mir_router_make_prerouting(struct userdata *u, mir_node *data)
 {
     pa_router     *router;
     mir_node      *start;
     mir_node      *end;
-    int            priority;
-    bool      done;
+    bool           done;
     mir_node      *target;
     uint32_t       stamp;
+    int            ndisplaced;
+    int            rank;
+    int            prio;
 
     pa_assert(u);
     pa_assert_se((router = u->router));
     pa_assert_se((data->implement == mir_stream));
 
-    priority = node_priority(u, data);
+    data->rtclass = pa_classify_guess_application_class(data);
+    data->rtrank  = class_rank(router, data->rtclass);
+
+    rank = data->rtrank;
     done = false;
     target = NULL;
+    ndisplaced = 0;
     stamp = pa_utils_new_stamp();
 
-    make_explicit_routes(u, stamp);
-
-    pa_audiomgr_delete_default_routes(u);
-
-    MIR_DLIST_FOR_EACH_BACKWARD(mir_node, rtprilist, start, &router->nodlist) {
-        if (start->implement == mir_device) {
-#if 0
-            if (start->direction == mir_output)
-                continue;       /* we should never get here */
-            if (!start->mux && !start->loop)
-                continue;       /* skip not looped back input nodes */
-#endif
-            if (!start->loop)
-                continue;       /* only looped back devices routed here */
-        }
-
-        if (priority >= node_priority(u, start)) {
+    /*
+     * The existing streams keep their routes. We only replay the
+     * constraints of the devices they use, in priority order, to find out
+     * what the new stream can use and which lower priority streams it
+     * pushes out of their devices. Only those are rerouted here; the rest
+     * is left to the next routing pass.
+     */
+    for (prio = router->prilist.nbucket - 1;  prio >= 0;  prio--) {
+        if (!done && rank >= prio) {
             if ((target = find_default_route(u, data, stamp)))
                 implement_preroute(u, data, target, stamp);
             done = true;
         }
 
-        if (start->stamp >= stamp)
-            continue;
+        MIR_DLIST_FOR_EACH_BACKWARD(mir_node, rtprilist, start,
+                                    &router->prilist.buckets[prio])
+        {
+            if (start->implement == mir_device && !start->loop)
+                continue;       /* only looped back devices routed here */
 
-        if ((end = find_default_route(u, start, stamp)))
-            implement_default_route(u, start, end, stamp);
-    }    
+            if (explicitly_routed(router, start))
+                continue;       /* rtend is stale; not a default route */
+
+            if (!(end = mir_node_find_by_index(u, start->rtend)))
+                continue;
+
+            if (!mir_constrain_applied(u, end, stamp)) {
+                mir_constrain_apply(u, end, stamp);
+                continue;
+            }
+
+            if (!done || start->rtdirty || !mir_constrain_blocked(u,end,stamp))
+                continue;
+
+            pa_log_debug("'%s' is displaced from '%s'",
+                         start->amname, end->amname);
+
+            if ((end = find_default_route(u, start, stamp)) &&
+                !mir_switch_default_link_exists(u, start, end))
+                implement_default_route(u, start, end, stamp);
+
+            /* the routing pass will account the change of the devices */
+            start->rtdirty = true;
+            ndisplaced++;
+        }
+    }
 
     if (!done && (target = find_default_route(u, data, stamp)))
         implement_preroute(u, data, target, stamp);
 
+    pa_log_debug("prerouting: %d stream(s) displaced", ndisplaced);
+
+    if (ndisplaced > 0)
+        pa_scheduler_request(u, PA_SCHEDULER_ROUTING);
+
     return target;
 }
 
 
 void mir_router_make_routing(struct userdata *u)
 {
-    static bool ongoing_routing;
-
     pa_router  *router;
     mir_node   *start;
     mir_node   *end;
     uint32_t    stamp;
+    int         prio;
 
     pa_assert(u);
     pa_assert_se((router = u->router));
@@ -514,12 +662,13 @@ void mir_router_make_routing(struct userdata *u)
 
     ongoing_routing = true;
     stamp = pa_utils_new_stamp();
+    router->next.nentry = 0;
 
     make_explicit_routes(u, stamp);
 
     pa_audiomgr_delete_default_routes(u);
 
-    MIR_DLIST_FOR_EACH_BACKWARD(mir_node,rtprilist, start, &router->nodlist) {
+    PRILIST_FOR_EACH_BACKWARD(rtprilist, start, prio, &router->prilist) {
         if (start->implement == mir_device) {
 #if 0
             if (start->direction == mir_output)
@@ -531,13 +680,23 @@ void mir_router_make_routing(struct userdata *u)
                 continue;       /* only looped back devices routed here */
         }
 
-        if (start->stamp >= stamp)
+        if (start->stamp >= stamp) {
+            start->rtdirty = true;
             continue;
+        }
 
-        if ((end = find_default_route(u, start, stamp)))
-            implement_default_route(u, start, end, stamp);
+        end = find_default_route(u, start, stamp);
+        plan_add(&router->next, start, end, start->rtend);
+
+        start->rtend = end ? end->index : PA_IDXSET_INVALID;
+        start->rtdirty = false;
     }    
 
+    plan_apply(u, stamp);
+    plan_store(u, ZONE_MASK_ALL);
+
+    clear_dirty(u);
+
     pa_audiomgr_send_default_routes(u);
 
     pa_fader_apply_volume_limits(u, stamp);
@@ -545,6 +704,161 @@ void mir_router_make_routing(struct userdata *u)
     ongoing_routing = false;
 }
 
+void mir_router_update_routing(struct userdata *u)
+{
+    pa_router  *router;
+    mir_node   *start;
+    uint32_t    stamp;
+    uint32_t    zones;
+    uint32_t    zone;
+    int         nstream;
+    int         nroute;
+    int         prio;
+
+    pa_assert(u);
+    pa_assert_se((router = u->router));
+
+    if (ongoing_routing)
+        return;
+
+    if (router->dirty.all) {
+        mir_router_make_routing(u);
+        return;
+    }
+
+    ongoing_routing = true;
+    stamp = pa_utils_new_stamp();
+    nstream = nroute = 0;
+    router->next.nentry = 0;
+
+    /*
+     * zones are routed shard by shard if none of the changed zones reach
+     * devices that interact with other zones through constraints
+     */
+    if (!get_dirty_zones(u, &zones))
+        zones = ZONE_MASK_ALL;
+    else {
+        for (zone = 0;  zone < MRP_ZONE_MAX;  zone++) {
+            if ((zones & ZONE_BIT(zone)) && !zone_is_isolated(u, zone)) {
+                zones = ZONE_MASK_ALL;
+                break;
+            }
+        }
+    }
+
+    make_explicit_routes(u, stamp);
+
+    pa_audiomgr_delete_default_routes(u);
+
+    if (zones != ZONE_MASK_ALL) {
+        keep_zone_routes(u, zones, stamp);
+
+        for (zone = 0;  zone < MRP_ZONE_MAX;  zone++) {
+            if (!(zones & ZONE_BIT(zone)))
+                continue;
+
+            PRILIST_FOR_EACH_BACKWARD(rtzonlist, start, prio,
+                                      &router->shards[zone].prilist)
+            {
+                if (start->implement == mir_device && !start->loop)
+                    continue;
+
+                nstream++;
+
+                if (update_stream_route(u, start, stamp))
+                    nroute++;
+            }
+        }
+    }
+    else {
+        PRILIST_FOR_EACH_BACKWARD(rtprilist, start, prio, &router->prilist) {
+            if (start->implement == mir_device && !start->loop)
+                continue;       /* only looped back devices routed here */
+
+            nstream++;
+
+            if (update_stream_route(u, start, stamp))
+                nroute++;
+        }
+    }
+
+    plan_apply(u, stamp);
+
+    if (zones != ZONE_MASK_ALL)
+        sync_shared_devices(u, zones, stamp);
+
+    plan_store(u, zones);
+
+    clear_dirty(u);
+
+    if (zones != ZONE_MASK_ALL) {
+        pa_log_debug("incremental routing in zones 0x%x: %d of %d streams "
+                     "rerouted", zones, nroute, nstream);
+    }
+    else {
+        pa_log_debug("incremental routing: %d of %d streams rerouted",
+                     nroute, nstream);
+    }
+
+    pa_audiomgr_send_default_routes(u);
+
+    pa_fader_update_volume_limits(u);
+
+    ongoing_routing = false;
+
+    if (router->verify && !verify_routing(u)) {
+        pa_log("incremental routing differs from the full one. "
+               "Doing full routing");
+        mir_router_make_routing(u);
+    }
+}
+
+
+void mir_router_mark_node_dirty(struct userdata *u, mir_node *node)
+{
+    mir_rtentry *rte;
+
+    pa_assert(u);
+    pa_assert(node);
+
+    if (node->implement == mir_stream)
+        node->rtdirty = true;
+    else {
+        MIR_DLIST_FOR_EACH(mir_rtentry, nodchain, rte, &node->rtentries) {
+            pa_assert(rte->group);
+            rte->group->dirty = true;
+        }
+
+        if (node->loop)
+            node->rtdirty = true;
+
+        mark_constrain_dirty(u, node);
+    }
+}
+
+void mir_router_mark_zone_dirty(struct userdata *u, uint32_t zone)
+{
+    pa_router *router;
+
+    pa_assert(u);
+    pa_assert_se((router = u->router));
+
+    if (zone < MRP_ZONE_MAX)
+        router->dirty.zones[zone] = true;
+    else
+        router->dirty.all = true;
+}
+
+void mir_router_mark_all_dirty(struct userdata *u)
+{
+    pa_router *router;
+
+    pa_assert(u);
+    pa_assert_se((router = u->router));
+
+    router->dirty.all = true;
+}
+
 
 
 bool mir_router_default_accept(struct userdata *u, mir_rtgroup *rtg,
@@ -634,11 +948,8 @@ int mir_router_default_compare(struct userdata *u, mir_rtgroup *rtg,
     if (n2->type == mir_null)
         return 1;
 
-    p1 = ((((n1->channels & 31) << 5) + n1->privacy) << 2) + n1->location;
-    p2 = ((((n2->channels & 31) << 5) + n2->privacy) << 2) + n2->location;
-
-    p1 = (p1 << 8) + ((n1->type - mir_device_class_begin) & 0xff);
-    p2 = (p2 << 8) + ((n2->type - mir_device_class_begin) & 0xff);
+    p1 = default_sort_priority(n1);
+    p2 = default_sort_priority(n2);
 
     return uint32_cmp(p1,p2);
 }
@@ -660,40 +971,86 @@ int mir_router_phone_compare(struct userdata *u, mir_rtgroup *rtg,
     if (n2->type == mir_null)
         return 1;
 
-    p1 = (n1->privacy << 8) + ((n1->type - mir_device_class_begin) & 0xff);
-    p2 = (n2->privacy << 8) + ((n2->type - mir_device_class_begin) & 0xff);
+    p1 = phone_sort_priority(n1);
+    p2 = phone_sort_priority(n2);
 
     return uint32_cmp(p1,p2);
 }
 
+double mir_router_default_sortkey(struct userdata *u, mir_rtgroup *rtg,
+                                  mir_node *node)
+{
+    (void)u;
+    (void)rtg;
+
+    pa_assert(node);
+
+    if (node->type == mir_null)
+        return -1.0;
+
+    return (double)default_sort_priority(node);
+}
+
+double mir_router_phone_sortkey(struct userdata *u, mir_rtgroup *rtg,
+                                mir_node *node)
+{
+    (void)u;
+    (void)rtg;
+
+    pa_assert(node);
+
+    if (node->type == mir_null)
+        return -1.0;
+
+    return (double)phone_sort_priority(node);
+}
+
 
 static void rtgroup_destroy(struct userdata *u, mir_rtgroup *rtg)
 {
+    mir_node    *node;
     mir_rtentry *rte, *n;
+    bool         found;
 
     pa_assert(u);
     pa_assert(rtg);
 
-    MIR_DLIST_FOR_EACH_SAFE(mir_rtentry, link, rte,n, &rtg->entries) {
-        remove_rtentry(u, rte);
+    while (rtg->nentry > 0) {
+        node = rtg->entries[rtg->nentry - 1];
+        found = false;
+
+        MIR_DLIST_FOR_EACH_SAFE(mir_rtentry,nodchain, rte,n, &node->rtentries){
+            if (rte->group == rtg) {
+                remove_rtentry(u, rte);
+                found = true;
+                break;
+            }
+        }
+
+        /* no back link; should not happen but do not loop forever */
+        if (!found)
+            rtg->nentry--;
     }
 
+    pa_xfree(rtg->entries);
+    pa_xfree(rtg->hotidx);
+    pa_xfree(rtg->keys);
     pa_xfree(rtg->name);
     pa_xfree(rtg);
 }
 
 static int rtgroup_print(mir_rtgroup *rtg, char *buf, int len)
 {
-    mir_rtentry *rte;
     mir_node *node;
+    size_t i;
     char *p, *e;
 
     e = (p = buf) + len;
 
     *buf = 0;
 
-    MIR_DLIST_FOR_EACH_BACKWARD(mir_rtentry, link, rte, &rtg->entries) {
-        node = rte->node;
+    for (i = rtg->nentry;  i > 0;  i--) {
+        node = rtg->entries[i - 1];
         if (p >= e)
             break;
         p += snprintf(p, (size_t)(e-p), " '%s'", node->amname);
@@ -726,70 +1083,242 @@ static void rtgroup_update_module_property(struct userdata *u,
     pa_proplist_sets(module->proplist, key, value+1); /* skip ' '@beginning */
 }
 
-static void add_rtentry(struct userdata *u,
-                        mir_direction    type,
-                        mir_rtgroup     *rtg,
-                        mir_node        *node)
+static void rtgroup_property_changed(struct userdata *u, mir_rtgroup *rtg)
 {
-    pa_router *router;
-    mir_rtentry *rte, *before;
-
     pa_assert(u);
     pa_assert(rtg);
-    pa_assert(node);
-    pa_assert_se((router = u->router));
 
-    if (!rtg->accept(u, rtg, node)) {
-        pa_log_debug("refuse node '%s' registration to routing group '%s'",
-                     node->amname, rtg->name);
-        return;
+    /*
+     * the property is serialized once per scheduler batch instead of
+     * on every membership change
+     */
+    if (!rtg->propdirty) {
+        rtg->propdirty = true;
+        pa_scheduler_request(u, PA_SCHEDULER_PROPERTIES);
     }
+}
+
+static bool update_rtgroup_properties(struct userdata *u,
+                                      mir_direction    type,
+                                      pa_hashmap      *table)
+{
+    mir_rtgroup *rtg;
+    void        *state;
+    bool         changed;
 
-    rte = pa_xnew0(mir_rtentry, 1);
+    pa_assert(u);
+    pa_assert(table);
 
-    MIR_DLIST_APPEND(mir_rtentry, nodchain, rte, &node->rtentries);
-    rte->group = rtg;
-    rte->node  = node;
+    changed = false;
 
-    MIR_DLIST_FOR_EACH(mir_rtentry, link, before, &rtg->entries) {
-        if (rtg->compare(u, rtg, node, before->node) < 0) {
-            MIR_DLIST_INSERT_BEFORE(mir_rtentry, link, rte, &before->link);
-            goto added;
+    PA_HASHMAP_FOREACH(rtg, table, state) {
+        if (rtg->propdirty) {
+            rtgroup_update_module_property(u, type, rtg);
+            rtg->propdirty = false;
+            changed = true;
         }
     }
 
-    MIR_DLIST_APPEND(mir_rtentry, link, rte, &rtg->entries);
-
- added:
-    rtgroup_update_module_property(u, type, rtg);
-    pa_log_debug("node '%s' added to routing group '%s'",
-                 node->amname, rtg->name);
+    return changed;
 }
 
-static void remove_rtentry(struct userdata *u, mir_rtentry *rte)
+static void add_to_rtgroups(struct userdata *u,
+                            mir_direction    type,
+                            pa_hashmap      *table,
+                            mir_node        *node)
 {
-    mir_rtgroup *rtg;
-    mir_node    *node;
+    pa_router    *router;
+    mir_rtgroup  *rtg;
+    mir_rtgroup **groups;
+    uint32_t     *mask;
+    void         *state;
+    size_t        ngroup;
+    size_t        i;
+    pa_usec_t     start;
 
     pa_assert(u);
-    pa_assert(rte);
-    pa_assert_se((rtg = rte->group));
-    pa_assert_se((node = rte->node));
+    pa_assert(table);
+    pa_assert(node);
+    pa_assert_se((router = u->router));
 
-    MIR_DLIST_UNLINK(mir_rtentry, link, rte);
-    MIR_DLIST_UNLINK(mir_rtentry, nodchain, rte);
+    if (!(ngroup = pa_hashmap_size(table)))
+        return;
+
+    groups = pa_xnew(mir_rtgroup *, ngroup);
+    mask   = pa_xnew0(uint32_t, (ngroup + 31) / 32);
+
+    i = 0;
+    PA_HASHMAP_FOREACH(rtg, table, state)
+        groups[i++] = rtg;
 
-    pa_xfree(rte);
+    start = pa_rtclock_now();
 
-    rtgroup_update_module_property(u, node->direction, rtg);
+    /*
+     * scripting evaluates all Lua defined accept functions in one go;
+     * without it every group decides on its own
+     */
+    if (u->scripting && router->batchacc)
+        pa_scripting_accept_rtgroups(u, node, groups, ngroup, mask);
+    else {
+        for (i = 0;  i < ngroup;  i++) {
+            if (groups[i]->accept(u, groups[i], node))
+                mask[i / 32] |= (uint32_t)1 << (i % 32);
+        }
+    }
+
+    router->accept.time += pa_rtclock_now() - start;
+    router->accept.nnode++;
+
+    for (i = 0;  i < ngroup;  i++) {
+        rtg = groups[i];
+
+        if (mask[i / 32] & ((uint32_t)1 << (i % 32)))
+            add_rtentry(u, type, rtg, node);
+        else {
+            pa_log_debug("refuse node '%s' registration to routing group '%s'",
+                         node->amname, rtg->name);
+        }
+    }
+
+    pa_xfree(mask);
+    pa_xfree(groups);
 }
 
-static void make_explicit_routes(struct userdata *u, uint32_t stamp)
+static void add_rtentry(struct userdata *u,
+                        mir_direction    type,
+                        mir_rtgroup     *rtg,
+                        mir_node        *node)
 {
     pa_router *router;
-    mir_connection *conn;
+    mir_rtentry *rte;
+    size_t slot;
+    size_t size;
+    double key;
+
+    pa_assert(u);
+    pa_assert(rtg);
+    pa_assert(node);
+    pa_assert_se((router = u->router));
+
+    rte = pa_slab_alloc(u, PA_SLAB_RTENTRY);
+
+    MIR_DLIST_APPEND(mir_rtentry, nodchain, rte, &node->rtentries);
+    rte->group = rtg;
+    rte->node  = node;
+
+    if (rtg->nentry >= rtg->maxentry) {
+        rtg->maxentry += 16;
+        size = sizeof(mir_node *) * rtg->maxentry;
+        rtg->entries = pa_xrealloc(rtg->entries, size);
+
+        size = sizeof(uint32_t) * rtg->maxentry;
+        rtg->hotidx = pa_xrealloc(rtg->hotidx, size);
+
+        if (rtg->sortkey) {
+            size = sizeof(double) * rtg->maxentry;
+            rtg->keys = pa_xrealloc(rtg->keys, size);
+        }
+    }
+
+    /* the key is computed once per node; it is cached in the group */
+    key  = rtg->sortkey ? rtg->sortkey(u, rtg, node) : 0.0;
+    slot = rtgroup_find_slot(u, rtg, node, key);
+
+    memmove(rtg->entries + slot + 1, rtg->entries + slot,
+            sizeof(mir_node *) * (rtg->nentry - slot));
+    rtg->entries[slot] = node;
+
+    memmove(rtg->hotidx + slot + 1, rtg->hotidx + slot,
+            sizeof(uint32_t) * (rtg->nentry - slot));
+    rtg->hotidx[slot] = node->hotidx;
+
+    if (rtg->sortkey) {
+        memmove(rtg->keys + slot + 1, rtg->keys + slot,
+                sizeof(double) * (rtg->nentry - slot));
+        rtg->keys[slot] = key;
+    }
+
+    rtg->nentry++;
+
+    rtg->dirty = true;
+    rtgroup_property_changed(u, rtg);
+    pa_log_debug("node '%s' added to routing group '%s'",
+                 node->amname, rtg->name);
+}
+
+static void remove_rtentry(struct userdata *u, mir_rtentry *rte)
+{
+    mir_rtgroup *rtg;
+    mir_node    *node;
+    size_t       i;
+
+    pa_assert(u);
+    pa_assert(rte);
+    pa_assert_se((rtg = rte->group));
+    pa_assert_se((node = rte->node));
+
+    for (i = 0;  i < rtg->nentry;  i++) {
+        if (rtg->entries[i] == node) {
+            rtg->nentry--;
+            memmove(rtg->entries + i, rtg->entries + i + 1,
+                    sizeof(mir_node *) * (rtg->nentry - i));
+            memmove(rtg->hotidx + i, rtg->hotidx + i + 1,
+                    sizeof(uint32_t) * (rtg->nentry - i));
+            if (rtg->sortkey) {
+                memmove(rtg->keys + i, rtg->keys + i + 1,
+                        sizeof(double) * (rtg->nentry - i));
+            }
+            break;
+        }
+    }
+
+    MIR_DLIST_UNLINK(mir_rtentry, nodchain, rte);
+
+    pa_slab_free(u, PA_SLAB_RTENTRY, rte);
+
+    rtg->dirty = true;
+    rtgroup_property_changed(u, rtg);
+}
+
+static size_t rtgroup_find_slot(struct userdata *u,
+                                mir_rtgroup     *rtg,
+                                mir_node        *node,
+                                double           key)
+{
+    size_t lo, hi, mid;
+
+    /*
+     * binary search for the first entry the new node compares below;
+     * equal entries stay in front of it, like with the former list walk
+     */
+    lo = 0;
+    hi = rtg->nentry;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+
+        if (rtg->sortkey) {
+            if (key < rtg->keys[mid])
+                hi = mid;
+            else
+                lo = mid + 1;
+        }
+        else if (rtg->compare(u, rtg, node, rtg->entries[mid]) < 0)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+
+    return lo;
+}
+
+static void make_explicit_routes(struct userdata *u, uint32_t stamp)
+{
+    pa_router *router;
+    mir_connection *conn;
     mir_node *from;
     mir_node *to;
+    bool moved;
 
     pa_assert(u);
     pa_assert_se((router = u->router));
@@ -806,6 +1335,8 @@ static void make_explicit_routes(struct userdata *u, uint32_t stamp)
             continue;
         }
 
+        moved = !stream_is_on_device(u, from, to);
+
         if (!mir_switch_setup_link(u, from, to, true))
             continue;
 
@@ -814,7 +1345,60 @@ static void make_explicit_routes(struct userdata *u, uint32_t stamp)
 
         if (to->implement == mir_device)
             mir_volume_add_limiting_class(u, to, volume_class(from), stamp);
+
+        /*
+         * the class mask of the devices might stay the same, but the
+         * streams on them changed and need their limits re-evaluated
+         */
+        pa_fader_mark_node_dirty(u, from, moved);
+        pa_fader_mark_node_dirty(u, to, moved);
+    }
+}
+
+static bool stream_is_on_device(struct userdata *u,
+                                mir_node        *stream,
+                                mir_node        *device)
+{
+    pa_core       *core;
+    pa_sink_input *sinp;
+    uint32_t       idx;
+
+    pa_assert(u);
+    pa_assert(stream);
+    pa_assert(device);
+    pa_assert_se((core = u->core));
+
+    if (stream->mux || device->implement != mir_device ||
+        device->direction != mir_output)
+        return false;
+
+    if (stream->loop)
+        idx = stream->loop->sink_input_index;
+    else if (stream->implement == mir_stream)
+        idx = stream->paidx;
+    else
+        return false;
+
+    if (!(sinp = pa_idxset_get_by_index(core->sink_inputs, idx)) ||
+        !sinp->sink)
+        return false;
+
+    return sinp->sink->index == device->paidx;
+}
+
+static bool explicitly_routed(pa_router *router, mir_node *node)
+{
+    mir_connection *conn;
+
+    pa_assert(router);
+    pa_assert(node);
+
+    MIR_DLIST_FOR_EACH(mir_connection,link, conn, &router->connlist) {
+        if (!conn->blocked && conn->from == node->index)
+            return true;
     }
+
+    return false;
 }
 
 
@@ -823,13 +1407,12 @@ static mir_node *find_default_route(struct userdata *u,
                                     uint32_t         stamp)
 {
     pa_router     *router = u->router;
-    mir_node_type  class  = pa_classify_guess_application_class(start);
-    mir_zone      *zone   = pa_zoneset_get_zone_by_name(u, start->zone);
+    mir_node_type  class  = start->rtclass;
+    mir_zone      *zone   = pa_zoneset_get_zone_by_index(u, start->zoneidx);
     mir_rtgroup ***cmap;
     mir_rtgroup  **zmap;
     mir_node      *end;
     mir_rtgroup   *rtg;
-    mir_rtentry   *rte;
 
     if (class < 0 || class > router->maplen) {
         pa_log_debug("can't route '%s': class %d is out of range (0 - %d)",
@@ -859,37 +1442,42 @@ static mir_node *find_default_route(struct userdata *u,
     pa_log_debug("using '%s' router group when routing '%s'",
                  rtg->name, start->amname);
 
-        
-    MIR_DLIST_FOR_EACH_BACKWARD(mir_rtentry, link, rte, &rtg->entries) {
-        if (!(end = rte->node)) {
-            pa_log("   node was null in mir_rtentry");
-            continue;
-        }
-        
-        if (end->ignore) {
-            pa_log_debug("   '%s' ignored. Skipping...",end->amname);
-            continue;
-        }
+    if ((end = select_default_route(u, start, rtg, stamp)))
+        pa_audiomgr_add_default_route(u, start, end);
+
+    return end;
+}
 
-        if (!end->available) {
-            pa_log_debug("   '%s' not available. Skipping...", end->amname);
+static mir_node *select_default_route(struct userdata *u,
+                                      mir_node        *start,
+                                      mir_rtgroup     *rtg,
+                                      uint32_t         stamp)
+{
+    const mir_node_hot *hot;
+    mir_node           *end;
+    uint8_t             flags;
+    size_t              i;
+
+    hot = mir_node_hot_table(u);
+
+    /*
+     * the ignored, unavailable and sinkless candidates are filtered
+     * from the hot table; only the survivors are looked at in full.
+     * A device with no sink requires a profile change which we do
+     * only for BT headsets; the hot ROUTABLE flag accounts for that.
+     */
+    for (i = rtg->nentry;  i > 0;  i--) {
+        flags = hot[rtg->hotidx[i - 1]].flags;
+
+        if ((flags & HOT_CANDIDATE_MASK) != HOT_CANDIDATE)
             continue;
-        }
 
-        if (end->paidx == PA_IDXSET_INVALID && !end->paport) {
-            /* requires profile change. We do it only for BT headsets */
-            if (end->type != mir_bluetooth_a2dp &&
-                end->type != mir_bluetooth_sco    )
-            {
-                pa_log_debug("   '%s' has no sink. Skipping...", end->amname);
-                continue;
-            }
-        }
+        end = rtg->entries[i - 1];
 
-        if (rte->stamp < stamp)
+        if (!mir_constrain_applied(u, end, stamp))
             mir_constrain_apply(u, end, stamp);
         else {
-            if (rte->blocked) {
+            if (mir_constrain_blocked(u, end, stamp)) {
                 pa_log_debug("   '%s' is blocked by constraints. Skipping...",
                              end->amname);
                 continue;
@@ -898,8 +1486,6 @@ static mir_node *find_default_route(struct userdata *u,
         
         pa_log_debug("routing '%s' => '%s'", start->amname, end->amname);
 
-        pa_audiomgr_add_default_route(u, start, end);
-        
         return end;
     }
     
@@ -908,6 +1494,513 @@ static mir_node *find_default_route(struct userdata *u,
     return NULL;
 }
 
+static bool reuse_default_route(struct userdata *u,
+                                mir_node        *start,
+                                uint32_t         stamp,
+                                mir_node       **end_ret)
+{
+    pa_router   *router = u->router;
+    mir_zone    *zone;
+    mir_rtgroup *rtg;
+    mir_node    *end;
+    mir_rtentry *rte;
+    bool         found;
+
+    *end_ret = NULL;
+
+    if (start->rtdirty)
+        return false;
+
+    if (!(rtg = get_stream_rtgroup(u, start, &zone)))
+        return false;
+
+    if (rtg->dirty || router->dirty.zones[zone->index])
+        return false;
+
+    if (start->rtend == PA_IDXSET_INVALID)
+        return true;            /* it was not routable and nothing changed */
+
+    if (!(end = mir_node_find_by_index(u, start->rtend)))
+        return false;
+
+    if (end->ignore || !end->available)
+        return false;
+
+    if (end->paidx == PA_IDXSET_INVALID && !end->paport &&
+        end->type != mir_bluetooth_a2dp && end->type != mir_bluetooth_sco)
+        return false;
+
+    found = false;
+
+    MIR_DLIST_FOR_EACH(mir_rtentry, nodchain, rte, &end->rtentries) {
+        if (rte->group == rtg) {
+            found = true;
+            break;
+        }
+    }
+
+    if (!found)
+        return false;
+
+    if (!mir_constrain_applied(u, end, stamp))
+        mir_constrain_apply(u, end, stamp);
+    else if (mir_constrain_blocked(u, end, stamp))
+        return false;
+
+    pa_audiomgr_add_default_route(u, start, end);
+
+    *end_ret = end;
+
+    return true;
+}
+
+static mir_rtgroup *get_stream_rtgroup(struct userdata *u,
+                                       mir_node        *start,
+                                       mir_zone       **zone_ret)
+{
+    pa_router     *router = u->router;
+    mir_node_type  class  = start->rtclass;
+    mir_zone      *zone   = pa_zoneset_get_zone_by_index(u, start->zoneidx);
+    mir_rtgroup ***cmap;
+    mir_rtgroup  **zmap;
+
+    *zone_ret = zone;
+
+    if (class < 0 || class >= (int)router->maplen || !zone)
+        return NULL;
+
+    switch (start->direction) {
+    case mir_input:     cmap = router->classmap.output;     break;
+    case mir_output:    cmap = router->classmap.input;      break;
+    default:            return NULL;
+    }
+
+    if (!(zmap = cmap[zone->index]))
+        return NULL;
+
+    return zmap[class];
+}
+
+static void mark_constrain_dirty(struct userdata *u, mir_node *node)
+{
+    mir_constr_link *cl;
+    mir_constr_link *c;
+    mir_rtentry     *rte;
+
+    (void)u;
+
+    MIR_DLIST_FOR_EACH(mir_constr_link, nodchain, cl, &node->constrains) {
+        MIR_DLIST_FOR_EACH(mir_constr_link, link, c, &cl->def->nodes) {
+            MIR_DLIST_FOR_EACH(mir_rtentry,nodchain, rte, &c->node->rtentries){
+                rte->group->dirty = true;
+            }
+        }
+    }
+}
+
+static bool get_dirty_zones(struct userdata *u, uint32_t *zones_ret)
+{
+    pa_router     *router = u->router;
+    mir_rtgroup  **maps[2];
+    mir_rtgroup   *rtg;
+    mir_node      *node;
+    uint32_t       zone;
+    uint32_t       zones;
+    size_t         i, j;
+    int            prio;
+    bool           zdirty;
+
+    *zones_ret = 0;
+
+    /* streams in unknown zones are not in any shard */
+    PRILIST_FOR_EACH_BACKWARD(rtprilist, node, prio, &router->prilist) {
+        if (node->rtdirty && node->zoneidx >= MRP_ZONE_MAX)
+            return false;
+    }
+
+    zones = 0;
+
+    for (zone = 0;  zone < MRP_ZONE_MAX;  zone++) {
+        zdirty = router->dirty.zones[zone];
+
+        maps[0] = router->classmap.input[zone];
+        maps[1] = router->classmap.output[zone];
+
+        for (i = 0;  !zdirty && i < 2;  i++) {
+            for (j = 0;  maps[i] && j < router->maplen;  j++) {
+                if ((rtg = maps[i][j]) && rtg->dirty) {
+                    zdirty = true;
+                    break;
+                }
+            }
+        }
+
+        PRILIST_FOR_EACH_BACKWARD_UNTIL(rtzonlist, node, prio,
+                                        &router->shards[zone].prilist, zdirty)
+        {
+            if (node->rtdirty) {
+                zdirty = true;
+                break;
+            }
+        }
+
+        if (zdirty)
+            zones |= ZONE_BIT(zone);
+    }
+
+    *zones_ret = zones;
+
+    return true;
+}
+
+static bool zone_is_isolated(struct userdata *u, uint32_t zone)
+{
+    pa_router     *router = u->router;
+    mir_rtgroup  **maps[2];
+    mir_rtgroup   *rtg;
+    size_t         i, j, k;
+
+    pa_assert(zone < MRP_ZONE_MAX);
+
+    maps[0] = router->classmap.input[zone];
+    maps[1] = router->classmap.output[zone];
+
+    for (i = 0;  i < 2;  i++) {
+        for (j = 0;  maps[i] && j < router->maplen;  j++) {
+            if (!(rtg = maps[i][j]))
+                continue;
+
+            for (k = 0;  k < rtg->nentry;  k++) {
+                if (!MIR_DLIST_EMPTY(rtg->entries[k]->constrains))
+                    return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static void keep_zone_routes(struct userdata *u,
+                             uint32_t         zones,
+                             uint32_t         stamp)
+{
+    pa_router        *router = u->router;
+    mir_rtplan       *plan;
+    mir_rtplan_entry *e;
+    mir_node         *start;
+    mir_node         *end;
+    uint32_t          zone;
+    size_t            i;
+
+    /* the untouched shards keep their routes; only audiomgr needs them */
+    for (zone = 0;  zone < MRP_ZONE_MAX;  zone++) {
+        if ((zones & ZONE_BIT(zone)))
+            continue;
+
+        plan = &router->shards[zone].plan;
+
+        for (i = 0;  i < plan->nentry;  i++) {
+            e = plan->entries + i;
+
+            if (!(start = mir_node_find_by_index(u, e->node)) ||
+                !(end   = mir_node_find_by_index(u, e->target))  )
+                continue;
+
+            if (start->stamp >= stamp) {
+                start->rtdirty = true;
+                continue;
+            }
+
+            pa_audiomgr_add_default_route(u, start, end);
+        }
+    }
+}
+
+static void sync_shared_devices(struct userdata *u,
+                                uint32_t         zones,
+                                uint32_t         stamp)
+{
+    pa_router        *router = u->router;
+    mir_rtplan       *plan;
+    mir_rtplan_entry *e;
+    mir_node         *start;
+    mir_node         *end;
+    uint32_t          zone;
+    uint32_t          z;
+    size_t            i;
+    bool              shared;
+
+    /*
+     * a device used by an untouched shard might have got or lost streams
+     * of the rerouted ones. Its volume limiting classes were rebuilt (or
+     * need to be) with the new stamp, so add the untouched streams again
+     */
+    for (zone = 0;  zone < MRP_ZONE_MAX;  zone++) {
+        if ((zones & ZONE_BIT(zone)))
+            continue;
+
+        plan = &router->shards[zone].plan;
+
+        for (i = 0;  i < plan->nentry;  i++) {
+            e = plan->entries + i;
+
+            shared = plan_has_target(&router->next, e->target);
+
+            for (z = 0;  !shared && z < MRP_ZONE_MAX;  z++) {
+                if ((zones & ZONE_BIT(z)))
+                    shared = plan_has_target(&router->shards[z].plan,
+                                             e->target);
+            }
+
+            if (!shared)
+                continue;
+
+            if (!(start = mir_node_find_by_index(u, e->node)) ||
+                !(end   = mir_node_find_by_index(u, e->target))  )
+                continue;
+
+            mir_volume_add_limiting_class(u, end, volume_class(start), stamp);
+            pa_fader_mark_node_dirty(u, end, true);
+        }
+    }
+}
+
+static bool update_stream_route(struct userdata *u,
+                                mir_node        *start,
+                                uint32_t         stamp)
+{
+    pa_router *router = u->router;
+    mir_node  *end;
+    mir_node  *prev;
+
+    if (start->stamp >= stamp) {
+        start->rtdirty = true;
+        return false;
+    }
+
+    if (reuse_default_route(u, start, stamp, &end)) {
+        plan_add(&router->next, start, end, start->rtend);
+        return false;
+    }
+
+    prev = mir_node_find_by_index(u, start->rtend);
+
+    end = find_default_route(u, start, stamp);
+    plan_add(&router->next, start, end, start->rtend);
+
+    start->rtend = end ? end->index : PA_IDXSET_INVALID;
+    start->rtdirty = false;
+
+    if (prev != end) {
+        /* the constraints of the old and the new device might have
+           changed what the lower priority streams are allowed to use */
+        if (prev)
+            mark_constrain_dirty(u, prev);
+        if (end)
+            mark_constrain_dirty(u, end);
+        else if (prev) {
+            /* no plan entry for unrouted streams */
+            pa_fader_mark_node_dirty(u, prev, true);
+            pa_fader_mark_node_dirty(u, start, true);
+        }
+    }
+
+    return true;
+}
+
+static void plan_add(mir_rtplan *plan,
+                     mir_node   *node,
+                     mir_node   *target,
+                     uint32_t    prev)
+{
+    mir_rtplan_entry *e;
+    size_t size;
+
+    pa_assert(plan);
+    pa_assert(node);
+
+    if (!target)
+        return;
+
+    if (plan->nentry >= plan->maxentry) {
+        plan->maxentry += 16;
+        size = sizeof(mir_rtplan_entry) * plan->maxentry;
+        plan->entries = pa_xrealloc(plan->entries, size);
+    }
+
+    e = plan->entries + plan->nentry++;
+
+    e->node   = node->index;
+    e->target = target->index;
+    e->prev   = prev;
+}
+
+static void plan_apply(struct userdata *u, uint32_t stamp)
+{
+    pa_router        *router = u->router;
+    mir_rtplan       *next   = &router->next;
+    mir_rtplan       *diff   = &router->diff;
+    mir_rtplan_entry *e;
+    mir_node         *start;
+    mir_node         *end;
+    mir_node         *prev;
+    bool              exists;
+    size_t            size;
+    size_t            i;
+
+    diff->nentry = 0;
+
+    for (i = 0;  i < next->nentry;  i++) {
+        e = next->entries + i;
+
+        if (!(start = mir_node_find_by_index(u, e->node)) ||
+            !(end   = mir_node_find_by_index(u, e->target))  )
+            continue;
+
+        /* only input nodes are on the prilist, ie. start is the source */
+        if ((exists = mir_switch_default_link_exists(u, start, end)))
+            mir_volume_add_limiting_class(u, end, volume_class(start), stamp);
+
+        if (exists && e->prev == e->target)
+            continue;
+
+        if (diff->nentry >= diff->maxentry) {
+            diff->maxentry += 16;
+            size = sizeof(mir_rtplan_entry) * diff->maxentry;
+            diff->entries = pa_xrealloc(diff->entries, size);
+        }
+
+        diff->entries[diff->nentry++] = *e;
+
+        if (!exists)
+            implement_default_route(u, start, end, stamp);
+
+        /* both the old and the new device has a different set of streams */
+        if ((prev = mir_node_find_by_index(u, e->prev)))
+            pa_fader_mark_node_dirty(u, prev, true);
+
+        pa_fader_mark_node_dirty(u, end, true);
+        pa_fader_mark_node_dirty(u, start, true);
+    }
+
+    pa_log_debug("routing plan: %zu routes, %zu to change",
+                 next->nentry, diff->nentry);
+}
+
+static void plan_store(struct userdata *u, uint32_t zones)
+{
+    pa_router        *router = u->router;
+    mir_rtplan       *next   = &router->next;
+    mir_rtplan       *plan;
+    mir_rtplan_entry *e;
+    mir_node         *start;
+    uint32_t          zone;
+    size_t            size;
+    size_t            i;
+
+    for (zone = 0;  zone < MRP_ZONE_MAX;  zone++) {
+        if ((zones & ZONE_BIT(zone)))
+            router->shards[zone].plan.nentry = 0;
+    }
+
+    for (i = 0;  i < next->nentry;  i++) {
+        e = next->entries + i;
+
+        if (!(start = mir_node_find_by_index(u, e->node)) ||
+            start->zoneidx >= MRP_ZONE_MAX ||
+            !(zones & ZONE_BIT(start->zoneidx)))
+            continue;
+
+        plan = &router->shards[start->zoneidx].plan;
+
+        if (plan->nentry >= plan->maxentry) {
+            plan->maxentry += 16;
+            size = sizeof(mir_rtplan_entry) * plan->maxentry;
+            plan->entries = pa_xrealloc(plan->entries, size);
+        }
+
+        plan->entries[plan->nentry++] = *e;
+    }
+}
+
+static bool plan_has_target(mir_rtplan *plan, uint32_t target)
+{
+    size_t i;
+
+    for (i = 0;  i < plan->nentry;  i++) {
+        if (plan->entries[i].target == target)
+            return true;
+    }
+
+    return false;
+}
+
+static void plan_free(mir_rtplan *plan)
+{
+    pa_assert(plan);
+
+    pa_xfree(plan->entries);
+
+    plan->nentry = plan->maxentry = 0;
+    plan->entries = NULL;
+}
+
+static void clear_dirty(struct userdata *u)
+{
+    pa_router   *router = u->router;
+    mir_rtgroup *rtg;
+    void        *state;
+
+    PA_HASHMAP_FOREACH(rtg, router->rtgroups.input, state) {
+        rtg->dirty = false;
+    }
+
+    PA_HASHMAP_FOREACH(rtg, router->rtgroups.output, state) {
+        rtg->dirty = false;
+    }
+
+    memset(&router->dirty, 0, sizeof(router->dirty));
+}
+
+static bool verify_routing(struct userdata *u)
+{
+    pa_router   *router = u->router;
+    mir_node    *start;
+    mir_node    *end;
+    mir_zone    *zone;
+    mir_rtgroup *rtg;
+    uint32_t     stamp;
+    uint32_t     rtend;
+    bool         match;
+    int          prio;
+
+    stamp = pa_utils_new_stamp();
+    match = true;
+
+    PRILIST_FOR_EACH_BACKWARD(rtprilist, start, prio, &router->prilist) {
+        if (start->implement == mir_device && !start->loop)
+            continue;
+
+        if (start->rtdirty)
+            continue;           /* explicitly routed */
+
+        if (!(rtg = get_stream_rtgroup(u, start, &zone)))
+            end = NULL;
+        else
+            end = select_default_route(u, start, rtg, stamp);
+
+        rtend = end ? end->index : PA_IDXSET_INVALID;
+
+        if (rtend != start->rtend) {
+            pa_log("routing mismatch for '%s': incremental %u, full %u",
+                   start->amname, start->rtend, rtend);
+            match = false;
+        }
+    }
+
+    return match;
+}
+
 static void implement_preroute(struct userdata *u,
                                mir_node        *data,
                                mir_node        *target,
@@ -944,22 +2037,165 @@ static int uint32_cmp(uint32_t v1, uint32_t v2)
     return 0;
 }
 
-static int node_priority(struct userdata *u, mir_node *node)
+static uint32_t default_sort_priority(mir_node *node)
 {
-    pa_router *router;
-    int class;
+    uint32_t p;
 
-    pa_assert(u);
-    pa_assert(node);
-    pa_assert_se((router = u->router));
-    pa_assert(router->priormap);
+    p = ((((node->channels & 31) << 5) + node->privacy) << 2) + node->location;
+    p = (p << 8) + ((node->type - mir_device_class_begin) & 0xff);
+
+    return p;
+}
+
+static uint32_t phone_sort_priority(mir_node *node)
+{
+    uint32_t p;
+
+    p = (node->privacy << 8) + ((node->type - mir_device_class_begin) & 0xff);
+
+    return p;
+}
 
-    class = pa_classify_guess_application_class(node);
+static int class_rank(pa_router *router, mir_node_type class)
+{
+    pa_assert(router);
+    pa_assert(router->rankmap);
 
     if (class < 0 || class >= (int)router->maplen)
-        return 0;
+        return router->defrank;
+
+    return router->rankmap[class];
+}
+
+static void update_class_ranks(pa_router *router)
+{
+    int *prios;
+    int  nprio;
+    int  pri;
+    int  i, j;
+
+    pa_assert(router);
+    pa_assert(router->priormap);
+    pa_assert(router->rankmap);
+
+    /*
+     * the distinct priorities in ascending order; the ones with no map
+     * slot have priority 0. Buckets are indexed by the position here, so
+     * sparse or negative priorities take no more buckets than needed.
+     */
+    prios = pa_xnew(int, router->maplen + 1);
+    prios[0] = 0;
+    nprio = 1;
+
+    for (i = 0;  i < (int)router->maplen;  i++) {
+        pri = router->priormap[i];
+
+        for (j = nprio;  j > 0 && prios[j-1] > pri;  j--)
+            ;
+        if (j > 0 && prios[j-1] == pri)
+            continue;
+
+        memmove(prios + j + 1, prios + j, (nprio - j) * sizeof(int));
+        prios[j] = pri;
+        nprio++;
+    }
+
+    for (i = 0;  i < (int)router->maplen;  i++) {
+        for (j = 0;  prios[j] != router->priormap[i];  j++)
+            ;
+        router->rankmap[i] = j;
+    }
+
+    for (j = 0;  prios[j] != 0;  j++)
+        ;
+    router->defrank = j;
+
+    pa_xfree(prios);
+}
+
+static void link_stream_node(pa_router *router, mir_node *node)
+{
+    prilist_add(&router->prilist, &node->rtprilist, node->rtrank);
+
+    if (node->zoneidx < MRP_ZONE_MAX) {
+        prilist_add(&router->shards[node->zoneidx].prilist,
+                    &node->rtzonlist, node->rtrank);
+    }
+}
+
+static void rebucket_stream_nodes(pa_router *router)
+{
+    MIR_DLIST_HEAD(nodes);
+    mir_node *node, *n;
+    int prio;
+
+    update_class_ranks(router);
+
+    /* collect them in priority order, then put them back by the new one */
+    for (prio = 0;  prio < router->prilist.nbucket;  prio++) {
+        MIR_DLIST_FOR_EACH_SAFE(mir_node, rtprilist, node,n,
+                                &router->prilist.buckets[prio])
+        {
+            MIR_DLIST_UNLINK(mir_node, rtprilist, node);
+            MIR_DLIST_UNLINK(mir_node, rtzonlist, node);
+            MIR_DLIST_APPEND(mir_node, rtprilist, node, &nodes);
+        }
+    }
+
+    MIR_DLIST_FOR_EACH_SAFE(mir_node, rtprilist, node,n, &nodes) {
+        MIR_DLIST_UNLINK(mir_node, rtprilist, node);
+        node->rtrank = class_rank(router, node->rtclass);
+        link_stream_node(router, node);
+    }
+}
+
+static void prilist_init(mir_rtprilist *pl)
+{
+    pa_assert(pl);
+
+    pl->nbucket = 0;
+    pl->buckets = NULL;
+}
+
+static void prilist_add(mir_rtprilist *pl, mir_dlist *link, int prio)
+{
+    mir_dlist *buckets;
+    mir_dlist *head;
+    int i;
+
+    pa_assert(pl);
+    pa_assert(link);
+    pa_assert(prio >= 0);
+
+    if (prio >= pl->nbucket) {
+        /* the listheads move; relink the neighbours of the old ones */
+        buckets = pa_xnew(mir_dlist, prio + 1);
+
+        for (i = 0;  i < prio + 1;  i++) {
+            head = buckets + i;
+
+            if (i >= pl->nbucket || MIR_DLIST_EMPTY(pl->buckets[i]))
+                MIR_DLIST_INIT(*head);
+            else {
+                *head = pl->buckets[i];
+                head->next->prev = head;
+                head->prev->next = head;
+            }
+        }
+
+        pa_xfree(pl->buckets);
+
+        pl->buckets = buckets;
+        pl->nbucket = prio + 1;
+    }
+
+    /* same priority: the later one goes after the earlier ones */
+    head = pl->buckets + prio;
 
-    return router->priormap[class];
+    link->prev = head->prev;
+    link->next = head;
+    head->prev->next = link;
+    head->prev = link;
 }
 
 static int volume_class(mir_node *node)
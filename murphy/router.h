@@ -32,6 +32,8 @@ typedef bool (*mir_rtgroup_accept_t)(struct userdata *, mir_rtgroup *,
                                           mir_node *);
 typedef int       (*mir_rtgroup_compare_t)(struct userdata *, mir_rtgroup *,
                                            mir_node *, mir_node *);
+typedef double    (*mir_rtgroup_sortkey_t)(struct userdata *, mir_rtgroup *,
+                                           mir_node *);
 
 typedef struct {
     pa_hashmap *input;
@@ -43,32 +45,78 @@ typedef struct {
     mir_rtgroup **output[MRP_ZONE_MAX];
 } pa_rtgroup_classmap;
 
+typedef struct {
+    uint32_t  node;            /**< index of the routed stream node */
+    uint32_t  target;          /**< index of the node it is routed to */
+    uint32_t  prev;            /**< where it was routed previously */
+} mir_rtplan_entry;
+
+typedef struct {
+    size_t             nentry;
+    size_t             maxentry;
+    mir_rtplan_entry  *entries;
+} mir_rtplan;
+
+typedef struct {
+    int         nbucket;       /**< number of priority ranks (highest + 1) */
+    mir_dlist  *buckets;       /**< listheads of nodes of the same priority */
+} mir_rtprilist;
+
+typedef struct {
+    mir_rtprilist  prilist;    /**< priorized stream nodes of the zone
+                                    (entry in node: rtzonlist) */
+    mir_rtplan     plan;       /**< default routes applied in the zone */
+} mir_rtshard;
+
+typedef struct {
+    bool  all;                 /**< everything needs to be rerouted */
+    bool  zones[MRP_ZONE_MAX]; /**< zones needing to be rerouted */
+} pa_router_dirty;
+
 struct pa_router {
     pa_rtgroup_hash      rtgroups;
     size_t               maplen;   /**< length of the class- and priormap */
     pa_rtgroup_classmap  classmap; /**< to map device node types to rtgroups */
     int                 *priormap; /**< stream node priorities */
-    mir_dlist            nodlist;  /**< priorized list of the stream nodes
+    int                 *rankmap;  /**< dense rank of the class priorities */
+    int                  defrank;  /**< rank of the classes with no map slot */
+    mir_rtprilist        prilist;  /**< priorized stream nodes
                                         (entry in node: rtprilist) */
+    mir_rtshard          shards[MRP_ZONE_MAX]; /**< per zone routing state */
     mir_dlist            connlist; /**< listhead of the connections */
+    pa_router_dirty      dirty;    /**< what changed since the last routing */
+    bool                 verify;   /**< cross-check incremental routing */
+    mir_rtplan           next;     /**< default routes under construction */
+    mir_rtplan           diff;     /**< routes changed by the last routing */
+    uint32_t             tblgen;   /**< generation of the routing tables
+                                        published in the module proplist */
+    bool                 batchacc; /**< evaluate Lua accepts in one call */
+    struct {
+        uint32_t         nnode;    /**< device nodes offered to rtgroups */
+        pa_usec_t        time;     /**< time spent deciding membership */
+    }                    accept;
 };
 
 
 struct mir_rtentry {
-    mir_dlist    link;        /**< rtgroup chain */
     mir_dlist    nodchain;    /**< node chain */
     mir_rtgroup *group;       /**< back pointer to the group  */
     mir_node    *node;        /**< pointer to the owning node */
-    bool         blocked;     /**< weather this routing entry is active */
-    uint32_t     stamp;
 };
 
 struct mir_rtgroup {
     char                  *name;      /**< name of the rtgroup */
-    mir_dlist              entries;   /**< listhead of ordered rtentries */
+    size_t                 nentry;    /**< number of member nodes */
+    size_t                 maxentry;  /**< allocated length of entries */
+    mir_node             **entries;   /**< member nodes in ascending order */
+    uint32_t              *hotidx;    /**< hot table slots of the entries */
+    double                *keys;      /**< sort keys of entries, if any */
     mir_rtgroup_accept_t   accept;    /**< wheter to accept a node or not */
     mir_rtgroup_compare_t  compare;   /**< comparision function for ordering */
+    mir_rtgroup_sortkey_t  sortkey;   /**< if set, used instead of compare */
     scripting_rtgroup     *scripting; /**< data for scripting, if any */
+    bool                   dirty;     /**< entries changed since last routing */
+    bool                   propdirty; /**< module property is out of date */
 };
 
 struct mir_connection {
@@ -81,7 +129,7 @@ struct mir_connection {
 };
 
 
-pa_router *pa_router_init(struct userdata *);
+pa_router *pa_router_init(struct userdata *, bool, bool);
 void pa_router_done(struct userdata *);
 
 void mir_router_assign_class_priority(struct userdata *, mir_node_type, int);
@@ -89,7 +137,8 @@ void mir_router_assign_class_priority(struct userdata *, mir_node_type, int);
 mir_rtgroup *mir_router_create_rtgroup(struct userdata *,
                                        mir_direction, const char *,
                                        mir_rtgroup_accept_t,
-                                       mir_rtgroup_compare_t);
+                                       mir_rtgroup_compare_t,
+                                       mir_rtgroup_sortkey_t);
 void mir_router_destroy_rtgroup(struct userdata *, mir_direction,
                                 const char *);
 bool mir_router_assign_class_to_rtgroup(struct userdata *, mir_node_type,
@@ -101,6 +150,11 @@ void mir_router_unregister_node(struct userdata *, mir_node *);
 
 mir_node *mir_router_make_prerouting(struct userdata *, mir_node *);
 void mir_router_make_routing(struct userdata *);
+void mir_router_update_routing(struct userdata *);
+
+void mir_router_mark_node_dirty(struct userdata *, mir_node *);
+void mir_router_mark_zone_dirty(struct userdata *, uint32_t);
+void mir_router_mark_all_dirty(struct userdata *);
 
 mir_connection *mir_router_add_explicit_route(struct userdata *, uint16_t,
                                               mir_node *, mir_node *);
@@ -108,6 +162,7 @@ void mir_router_remove_explicit_route(struct userdata *, mir_connection *);
 
 
 int mir_router_print_rtgroups(struct userdata *, char *, int);
+void mir_router_update_module_properties(struct userdata *);
 
 bool mir_router_default_accept(struct userdata *, mir_rtgroup *,
                                     mir_node *);
@@ -119,6 +174,11 @@ int mir_router_default_compare(struct userdata *, mir_rtgroup *,
 int mir_router_phone_compare(struct userdata *, mir_rtgroup *,
                              mir_node *, mir_node *);
 
+double mir_router_default_sortkey(struct userdata *, mir_rtgroup *,
+                                  mir_node *);
+double mir_router_phone_sortkey(struct userdata *, mir_rtgroup *,
+                                mir_node *);
+
 
 #endif  /* foomirrouterfoo */
 
@@ -0,0 +1,333 @@
+/*
+ * module-murphy-ivi -- PulseAudio module for providing audio routing support
+ * Copyright (c) 2012, Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St - Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <pulsecore/pulsecore-config.h>
+
+#include <pulse/timeval.h>
+#include <pulse/rtclock.h>
+#include <pulse/proplist.h>
+#include <pulsecore/core.h>
+#include <pulsecore/core-util.h>
+
+#include "scheduler.h"
+#include "router.h"
+#include "fader.h"
+#include "resource.h"
+
+#define MAX_BATCH_WINDOW  100  /* msec */
+
+struct pa_scheduler {
+    struct userdata    *u;
+    long                window;   /**< batch collection time in msec */
+    uint32_t            pending;  /**< mask of the pending tasks */
+    uint32_t            nreq;     /**< requests in the current batch */
+    bool                running;  /**< batch is being run */
+    bool                bulk;     /**< bulk load, tasks are held back */
+    pa_defer_event     *defer;    /**< for zero length window */
+    pa_time_event      *timer;    /**< for non-zero length window */
+    pa_scheduler_stats  stats;
+};
+
+static void arm(pa_scheduler *);
+static void disarm(pa_scheduler *);
+static void run_batch(pa_scheduler *);
+
+static void defer_cb(pa_mainloop_api *, pa_defer_event *, void *);
+static void timer_cb(pa_mainloop_api *, pa_time_event *,
+                     const struct timeval *, void *);
+
+
+pa_scheduler *pa_scheduler_init(struct userdata *u, const char *window_str)
+{
+    pa_scheduler *scheduler;
+    pa_mainloop_api *mainloop;
+
+    pa_assert(u);
+    pa_assert(u->core);
+    pa_assert_se((mainloop = u->core->mainloop));
+
+    scheduler = pa_xnew0(pa_scheduler, 1);
+    scheduler->u = u;
+
+    if (!window_str || pa_atol(window_str, &scheduler->window) < 0)
+        scheduler->window = 0;
+
+    if (scheduler->window < 0)
+        scheduler->window = 0;
+
+    if (scheduler->window > MAX_BATCH_WINDOW)
+        scheduler->window = MAX_BATCH_WINDOW;
+
+    scheduler->defer = mainloop->defer_new(mainloop, defer_cb, scheduler);
+    mainloop->defer_enable(scheduler->defer, 0);
+
+    pa_log_info("scheduler batch window: %ld ms", scheduler->window);
+
+    return scheduler;
+}
+
+void pa_scheduler_done(struct userdata *u)
+{
+    pa_scheduler *scheduler;
+    pa_mainloop_api *mainloop;
+
+    if (u && (scheduler = u->scheduler)) {
+        pa_assert_se((mainloop = u->core->mainloop));
+
+        if (scheduler->defer)
+            mainloop->defer_free(scheduler->defer);
+
+        if (scheduler->timer)
+            mainloop->time_free(scheduler->timer);
+
+        pa_log_debug("scheduler: %u batches, %u requests, %u merged",
+                     scheduler->stats.nbatch, scheduler->stats.nrequest,
+                     scheduler->stats.nmerged);
+
+        pa_xfree(scheduler);
+
+        u->scheduler = NULL;
+    }
+}
+
+
+void pa_scheduler_request(struct userdata *u, uint32_t tasks)
+{
+    pa_scheduler *scheduler;
+
+    pa_assert(u);
+
+    /* requests made while the module is being torn down are dropped */
+    if (!(scheduler = u->scheduler))
+        return;
+
+    scheduler->stats.nrequest++;
+    scheduler->nreq++;
+
+    if ((scheduler->pending & tasks) == tasks)
+        scheduler->stats.nmerged++;
+
+    if (!scheduler->pending && !scheduler->running && !scheduler->bulk)
+        arm(scheduler);
+
+    scheduler->pending |= tasks;
+}
+
+void pa_scheduler_bulk_begin(struct userdata *u)
+{
+    pa_scheduler *scheduler;
+
+    pa_assert(u);
+    pa_assert_se((scheduler = u->scheduler));
+    pa_assert(!scheduler->bulk);
+
+    pa_log_debug("scheduler: bulk load starts");
+
+    disarm(scheduler);
+    scheduler->bulk = true;
+}
+
+void pa_scheduler_bulk_end(struct userdata *u)
+{
+    pa_scheduler *scheduler;
+
+    pa_assert(u);
+    pa_assert_se((scheduler = u->scheduler));
+    pa_assert(scheduler->bulk);
+
+    scheduler->bulk = false;
+
+    pa_log_debug("scheduler: bulk load ends, %u request(s) held back",
+                 scheduler->nreq);
+
+    /* everything held back is done in a single batch right now */
+    if (scheduler->pending && !scheduler->running)
+        run_batch(scheduler);
+}
+
+bool pa_scheduler_in_bulk(struct userdata *u)
+{
+    pa_scheduler *scheduler;
+
+    pa_assert(u);
+
+    if (!(scheduler = u->scheduler))
+        return false;
+
+    return scheduler->bulk;
+}
+
+void pa_scheduler_publish_stats(struct userdata *u, pa_proplist *pl)
+{
+    pa_scheduler *scheduler;
+
+    pa_assert(u);
+    pa_assert(pl);
+
+    if (!(scheduler = u->scheduler))
+        return;
+
+    pa_proplist_setf(pl, PA_PROP_STATS ".scheduler.batches", "%u",
+                     scheduler->stats.nbatch);
+    pa_proplist_setf(pl, PA_PROP_STATS ".scheduler.requests", "%u",
+                     scheduler->stats.nrequest);
+    pa_proplist_setf(pl, PA_PROP_STATS ".scheduler.merged", "%u",
+                     scheduler->stats.nmerged);
+}
+
+
+static void arm(pa_scheduler *scheduler)
+{
+    pa_core *core;
+    pa_usec_t when;
+
+    pa_assert(scheduler);
+    pa_assert_se((core = scheduler->u->core));
+
+    if (!scheduler->window)
+        core->mainloop->defer_enable(scheduler->defer, 1);
+    else {
+        /* monotonic time, so that clock steps do not move the batch */
+        when = pa_rtclock_now() +
+               (pa_usec_t)scheduler->window * PA_USEC_PER_MSEC;
+
+        if (scheduler->timer)
+            pa_core_rttime_restart(core, scheduler->timer, when);
+        else {
+            scheduler->timer = pa_core_rttime_new(core, when,
+                                                  timer_cb, scheduler);
+        }
+    }
+}
+
+static void disarm(pa_scheduler *scheduler)
+{
+    pa_mainloop_api *mainloop;
+
+    pa_assert(scheduler);
+    pa_assert_se((mainloop = scheduler->u->core->mainloop));
+
+    mainloop->defer_enable(scheduler->defer, 0);
+
+    if (scheduler->timer)
+        mainloop->time_restart(scheduler->timer, NULL);
+}
+
+static void run_batch(pa_scheduler *scheduler)
+{
+    struct userdata *u;
+    uint32_t nreq;
+    bool routed;
+
+    pa_assert(scheduler);
+    pa_assert_se((u = scheduler->u));
+
+    nreq = scheduler->nreq;
+    scheduler->nreq = 0;
+    scheduler->running = true;
+    scheduler->stats.nbatch++;
+
+    pa_log_debug("batch %u starts: %u request(s), tasks 0x%x",
+                 scheduler->stats.nbatch, nreq, scheduler->pending);
+
+    /*
+     * every task is consumed right before it is run, so that
+     * the requests made by the preceeding tasks are merged in
+     */
+    if ((scheduler->pending & PA_SCHEDULER_RESOURCE_RECORDING)) {
+        scheduler->pending &= ~PA_SCHEDULER_RESOURCE_RECORDING;
+        pa_resource_enforce_policies(u, PA_RESOURCE_RECORDING);
+    }
+
+    if ((scheduler->pending & PA_SCHEDULER_RESOURCE_PLAYBACK)) {
+        scheduler->pending &= ~PA_SCHEDULER_RESOURCE_PLAYBACK;
+        pa_resource_enforce_policies(u, PA_RESOURCE_PLAYBACK);
+    }
+
+    routed = false;
+
+    if ((scheduler->pending & PA_SCHEDULER_ROUTING)) {
+        scheduler->pending &= ~PA_SCHEDULER_ROUTING;
+        mir_router_update_routing(u);
+        routed = true;
+    }
+
+    if ((scheduler->pending & PA_SCHEDULER_VOLUME)) {
+        scheduler->pending &= ~PA_SCHEDULER_VOLUME;
+
+        /* routing applies the volume limits as well */
+        if (!routed)
+            pa_fader_update_volume_limits(u);
+    }
+
+    if ((scheduler->pending & PA_SCHEDULER_PROPERTIES)) {
+        scheduler->pending &= ~PA_SCHEDULER_PROPERTIES;
+        mir_router_update_module_properties(u);
+    }
+
+    scheduler->running = false;
+
+    if (scheduler->pending) {
+        pa_log_debug("tasks 0x%x were requested while running batch %u",
+                     scheduler->pending, scheduler->stats.nbatch);
+        arm(scheduler);
+    }
+}
+
+
+static void defer_cb(pa_mainloop_api *m, pa_defer_event *e, void *userdata)
+{
+    pa_scheduler *scheduler = userdata;
+
+    (void)e;
+
+    pa_assert(scheduler);
+
+    m->defer_enable(scheduler->defer, 0);
+
+    run_batch(scheduler);
+}
+
+static void timer_cb(pa_mainloop_api *m, pa_time_event *e,
+                     const struct timeval *t, void *userdata)
+{
+    pa_scheduler *scheduler = userdata;
+
+    (void)t;
+
+    pa_assert(scheduler);
+
+    m->time_restart(e, NULL);
+
+    run_batch(scheduler);
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
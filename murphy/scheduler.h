@@ -0,0 +1,70 @@
+/*
+ * module-murphy-ivi -- PulseAudio module for providing audio routing support
+ * Copyright (c) 2012, Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St - Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ *
+ */
+#ifndef foomirschedulerfoo
+#define foomirschedulerfoo
+
+#include <sys/types.h>
+
+#include "userdata.h"
+#include "resource.h"
+
+/* the tasks are run in the order of their bits */
+#define PA_SCHEDULER_RESOURCE_RECORDING  (1 << 0)
+#define PA_SCHEDULER_RESOURCE_PLAYBACK   (1 << 1)
+#define PA_SCHEDULER_ROUTING             (1 << 2)
+#define PA_SCHEDULER_VOLUME              (1 << 3)
+#define PA_SCHEDULER_PROPERTIES          (1 << 4)
+
+#define PA_SCHEDULER_ALL           (PA_SCHEDULER_RESOURCE_RECORDING |   \
+                                    PA_SCHEDULER_RESOURCE_PLAYBACK  |   \
+                                    PA_SCHEDULER_ROUTING            |   \
+                                    PA_SCHEDULER_VOLUME)
+
+#define PA_SCHEDULER_RESOURCE(t)   ((t) == PA_RESOURCE_PLAYBACK ?       \
+                                    PA_SCHEDULER_RESOURCE_PLAYBACK :    \
+                                    PA_SCHEDULER_RESOURCE_RECORDING)
+
+typedef struct {
+    uint32_t   nbatch;       /**< number of batches run */
+    uint32_t   nrequest;     /**< number of requests received */
+    uint32_t   nmerged;      /**< requests merged to an already pending one */
+} pa_scheduler_stats;
+
+pa_scheduler *pa_scheduler_init(struct userdata *, const char *);
+void pa_scheduler_done(struct userdata *);
+
+void pa_scheduler_request(struct userdata *, uint32_t);
+
+void pa_scheduler_bulk_begin(struct userdata *);
+void pa_scheduler_bulk_end(struct userdata *);
+bool pa_scheduler_in_bulk(struct userdata *);
+
+void pa_scheduler_publish_stats(struct userdata *, pa_proplist *);
+
+#endif  /* foomirschedulerfoo */
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
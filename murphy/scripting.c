@@ -56,6 +56,24 @@
 
 #define USERDATA           "murphy_ivi_userdata"
 
+#define ACCEPT_BATCH_MAX   32
+
+/*
+ * called as chunk(node, group1, accept1, group2, accept2, ...);
+ * returns the bitmask of the groups that accepted the node
+ */
+#define ACCEPT_BATCH                                            \
+    "local args = {...}\n"                                      \
+    "local node = args[1]\n"                                    \
+    "local mask, bit = 0, 1\n"                                  \
+    "for i = 2, #args, 2 do\n"                                  \
+    "    if args[i+1](args[i], node) == true then\n"            \
+    "        mask = mask + bit\n"                               \
+    "    end\n"                                                 \
+    "    bit = bit * 2\n"                                       \
+    "end\n"                                                     \
+    "return mask\n"
+
 #undef  MRP_LUA_ENTER
 #define MRP_LUA_ENTER                                           \
     pa_log_debug("%s() enter", __FUNCTION__)
@@ -76,6 +94,7 @@ typedef void (*update_func_t)(struct userdata *);
 struct pa_scripting {
     lua_State *L;
     bool configured;
+    int accept_batch;      /**< registry ref of the batched accept chunk */
 };
 
 struct scripting_import {
@@ -121,7 +140,9 @@ struct scripting_rtgroup {
     mir_rtgroup        *rtg;
     mir_direction       type;
     mrp_funcbridge_t   *accept;
+    int                 acceptref;  /**< registry ref of a Lua accept */
     mrp_funcbridge_t   *compare;
+    mrp_funcbridge_t   *sortkey;
 };
 
 typedef struct {
@@ -133,6 +154,7 @@ typedef struct {
     const char         *name;
     bool                needres;
     const char         *role;
+    bool                launcher;
     pa_nodeset_resdef   resource;
 } map_t;
 
@@ -210,6 +232,7 @@ typedef enum {
     CHANNELS,
     LOCATION,
     PRIORITY,
+    SORT_KEY,
     AVAILABLE,
     CALCULATE,
     CONDITION,
@@ -268,8 +291,12 @@ static int  rtgroup_tostring(lua_State *);
 static void rtgroup_destroy(void *);
 
 static bool rtgroup_accept(struct userdata *, mir_rtgroup *, mir_node *);
+static void rtgroup_accept_batch(struct userdata *, mir_node *,
+                                 mir_rtgroup **, size_t *, size_t,
+                                 uint32_t *);
 static int  rtgroup_compare(struct userdata *, mir_rtgroup *,
                             mir_node *, mir_node *);
+static double rtgroup_sortkey(struct userdata *, mir_rtgroup *, mir_node *);
 
 static bool accept_bridge(lua_State *, void *, const char *,
                           mrp_funcbridge_value_t *, char *,
@@ -277,6 +304,9 @@ static bool accept_bridge(lua_State *, void *, const char *,
 static bool compare_bridge(lua_State *, void *, const char *,
                            mrp_funcbridge_value_t *, char *,
                            mrp_funcbridge_value_t *);
+static bool sortkey_bridge(lua_State *, void *, const char *,
+                           mrp_funcbridge_value_t *, char *,
+                           mrp_funcbridge_value_t *);
 static bool change_bridge(lua_State *, void *, const char *,
                            mrp_funcbridge_value_t *, char *,
                            mrp_funcbridge_value_t *);
@@ -474,6 +504,7 @@ pa_scripting *pa_scripting_init(struct userdata *u)
     pa_assert(u);
 
     scripting = pa_xnew0(pa_scripting, 1);
+    scripting->accept_batch = LUA_NOREF;
 
     if (!(L = lua_newstate(alloc, u)))
         pa_log("failed to initialize Lua");
@@ -495,6 +526,14 @@ pa_scripting *pa_scripting_init(struct userdata *u)
         define_constants(L);
         register_methods(L);
 
+        if (luaL_loadstring(L, ACCEPT_BATCH)) {
+            pa_log("failed to compile batched accept: %s",
+                   lua_tostring(L, -1));
+            lua_pop(L, 1);
+        }
+        else
+            scripting->accept_batch = luaL_ref(L, LUA_REGISTRYINDEX);
+
         lua_pushlightuserdata(L, u);
         lua_setglobal(L, USERDATA);
 
@@ -515,6 +554,49 @@ void pa_scripting_done(struct userdata *u)
     }
 }
 
+void pa_scripting_accept_rtgroups(struct userdata *u,
+                                  mir_node        *node,
+                                  mir_rtgroup    **groups,
+                                  size_t           ngroup,
+                                  uint32_t        *mask)
+{
+    pa_scripting *scripting;
+    scripting_rtgroup *rtgs;
+    mir_rtgroup *rtg;
+    size_t batch[ACCEPT_BATCH_MAX];
+    size_t nbatch;
+    size_t i;
+
+    pa_assert(u);
+    pa_assert_se((scripting = u->scripting));
+    pa_assert(node);
+    pa_assert(groups || !ngroup);
+    pa_assert(mask);
+
+    nbatch = 0;
+
+    for (i = 0;  i < ngroup;  i++) {
+        rtg = groups[i];
+
+        if (scripting->L && scripting->accept_batch != LUA_NOREF &&
+            node->scripting && (rtgs = rtg->scripting) &&
+            rtgs->acceptref != LUA_NOREF)
+        {
+            batch[nbatch++] = i;
+
+            if (nbatch == ACCEPT_BATCH_MAX) {
+                rtgroup_accept_batch(u, node, groups, batch, nbatch, mask);
+                nbatch = 0;
+            }
+        }
+        else if (rtg->accept(u, rtg, node))
+            mask[i / 32] |= (uint32_t)1 << (i % 32);
+    }
+
+    if (nbatch > 0)
+        rtgroup_accept_batch(u, node, groups, batch, nbatch, mask);
+}
+
 bool pa_scripting_dofile(struct userdata *u, const char *file)
 {
     pa_scripting *scripting;
@@ -842,6 +924,9 @@ static void import_data_changed(struct userdata *u,
             }
         }
 
+        /* limit functions might depend on the imported data */
+        mir_volume_invalidate_limits(u);
+
         arg.pointer = imp;
 
         if (!mrp_funcbridge_call_from_c(L, imp->update, "o", &arg, &t, &ret)) {
@@ -1393,7 +1478,9 @@ static int rtgroup_create(lua_State *L)
     const char *name = NULL;
     mir_direction type = 0;
     mrp_funcbridge_t *accept = NULL;
+    int acceptref = LUA_NOREF;
     mrp_funcbridge_t *compare = NULL;
+    mrp_funcbridge_t *sortkey = NULL;
     char id[256];
 
     MRP_LUA_ENTER;
@@ -1411,6 +1498,7 @@ static int rtgroup_create(lua_State *L)
         case NODE_TYPE: type    = luaL_checkint(L, -1);                  break;
         case ACCEPT:    accept  = mrp_funcbridge_create_luafunc(L, -1);  break;
         case COMPARE:   compare = mrp_funcbridge_create_luafunc(L, -1);  break;
+        case SORT_KEY:  sortkey = mrp_funcbridge_create_luafunc(L, -1);  break;
         default:        luaL_error(L, "bad field '%s'", fldnam);         break;
         }
 
@@ -1422,25 +1510,39 @@ static int rtgroup_create(lua_State *L)
         luaL_error(L, "missing or invalid node_type");
     if (!accept)
         luaL_error(L, "missing or invalid accept field");
-    if (!compare)
-        luaL_error(L, "missing or invalid compare field");
+    if (!compare && !sortkey)
+        luaL_error(L, "missing or invalid compare or sort_key field");
 
     make_id(id,sizeof(id), "%s_%sput", name, (type == mir_input) ? "in":"out");
 
     rtgs = (scripting_rtgroup *)mrp_lua_create_object(L, RTGROUP_CLASS, id,0);
 
     rtg  = mir_router_create_rtgroup(u, type, pa_xstrdup(name),
-                                     rtgroup_accept, rtgroup_compare);
+                                     rtgroup_accept,
+                                     compare ? rtgroup_compare : NULL,
+                                     sortkey ? rtgroup_sortkey : NULL);
     if (!rtgs || !rtg)
         luaL_error(L, "failed to create routing group '%s'", id);
 
+    /*
+     * keep the plain function for batched evaluation. The reference is
+     * taken only here, as the errors above would leak it.
+     */
+    lua_getfield(L, 2, "accept");
+    if (lua_isfunction(L, -1))
+        acceptref = luaL_ref(L, LUA_REGISTRYINDEX);
+    else
+        lua_pop(L, 1);
+
     rtg->scripting = rtgs;
 
     rtgs->userdata = u;
     rtgs->rtg = rtg;
     rtgs->type = type;
     rtgs->accept = accept;
+    rtgs->acceptref = acceptref;
     rtgs->compare = compare;
+    rtgs->sortkey = sortkey;
 
     MRP_LUA_LEAVE(1);
 }
@@ -1501,6 +1603,7 @@ static int rtgroup_tostring(lua_State *L)
 static void rtgroup_destroy(void *data)
 {
     scripting_rtgroup *rtgs = (scripting_rtgroup *)data;
+    struct userdata *u;
     mir_rtgroup *rtg;
 
     MRP_LUA_ENTER;
@@ -1510,6 +1613,13 @@ static void rtgroup_destroy(void *data)
 
     rtg->scripting = NULL;
 
+    if (rtgs->acceptref != LUA_NOREF && (u = rtgs->userdata) &&
+        u->scripting && u->scripting->L)
+    {
+        luaL_unref(u->scripting->L, LUA_REGISTRYINDEX, rtgs->acceptref);
+        rtgs->acceptref = LUA_NOREF;
+    }
+
     MRP_LUA_LEAVE_NOARG;
 }
 
@@ -1561,6 +1671,62 @@ static bool rtgroup_accept(struct userdata *u,
     return accept;
 }
 
+static void rtgroup_accept_batch(struct userdata *u,
+                                 mir_node *node,
+                                 mir_rtgroup **groups,
+                                 size_t *batch,
+                                 size_t nbatch,
+                                 uint32_t *mask)
+{
+    pa_scripting *scripting;
+    lua_State *L;
+    scripting_rtgroup *rtgs;
+    mir_rtgroup *rtg;
+    uint32_t bits;
+    size_t i, j;
+    int top;
+
+    pa_assert(u);
+    pa_assert_se((scripting = u->scripting));
+    pa_assert_se((L = scripting->L));
+    pa_assert(node);
+    pa_assert(node->scripting);
+    pa_assert(nbatch <= ACCEPT_BATCH_MAX);
+
+    top = lua_gettop(L);
+
+    lua_rawgeti(L, LUA_REGISTRYINDEX, scripting->accept_batch);
+    mrp_lua_push_object(L, node->scripting);
+
+    for (i = 0;  i < nbatch;  i++) {
+        pa_assert_se((rtgs = groups[batch[i]]->scripting));
+        mrp_lua_push_object(L, rtgs);
+        lua_rawgeti(L, LUA_REGISTRYINDEX, rtgs->acceptref);
+    }
+
+    if (!lua_pcall(L, 1 + 2 * (int)nbatch, 1, 0))
+        bits = (uint32_t)lua_tonumber(L, -1);
+    else {
+        pa_log("batched accept failed: %s", lua_tostring(L, -1));
+
+        /* one of the functions failed; find out the rest one by one */
+        for (bits = 0, i = 0;  i < nbatch;  i++) {
+            rtg = groups[batch[i]];
+            if (rtgroup_accept(u, rtg, node))
+                bits |= (uint32_t)1 << i;
+        }
+    }
+
+    lua_settop(L, top);
+
+    for (i = 0;  i < nbatch;  i++) {
+        if (bits & ((uint32_t)1 << i)) {
+            j = batch[i];
+            mask[j / 32] |= (uint32_t)1 << (j % 32);
+        }
+    }
+}
+
 static int rtgroup_compare(struct userdata *u,
                            mir_rtgroup *rtg,
                            mir_node *node1,
@@ -1605,6 +1771,47 @@ static int rtgroup_compare(struct userdata *u,
     return result;
 }
 
+static double rtgroup_sortkey(struct userdata *u,
+                              mir_rtgroup *rtg,
+                              mir_node *node)
+{
+    pa_scripting *scripting;
+    lua_State *L;
+    scripting_rtgroup *rtgs;
+    mrp_funcbridge_value_t  args[2];
+    char rt;
+    mrp_funcbridge_value_t  rv;
+    double key;
+
+    pa_assert(u);
+    pa_assert_se((scripting = u->scripting));
+    pa_assert_se((L = scripting->L));
+    pa_assert(rtg);
+    pa_assert_se((rtgs = rtg->scripting));
+    pa_assert(u == rtgs->userdata);
+    pa_assert(rtgs->sortkey);
+    pa_assert(node);
+
+    key = 0.0;
+
+    if ((rtgs = rtg->scripting) && node->scripting) {
+
+        args[0].pointer = rtgs;
+        args[1].pointer = node->scripting;
+
+        if (!mrp_funcbridge_call_from_c(L, rtgs->sortkey, "oo",args, &rt,&rv))
+            pa_log("failed to call sort_key function");
+        else {
+            if (rt != MRP_FUNCBRIDGE_FLOATING)
+                pa_log("sort_key function returned invalid type");
+            else
+                key = rv.floating;
+        }
+    }
+
+    return key;
+}
+
 
 static bool accept_bridge(lua_State *L, void *data,
                           const char *signature, mrp_funcbridge_value_t *args,
@@ -1690,6 +1897,47 @@ static bool compare_bridge(lua_State *L, void *data,
 }
 
 
+static bool sortkey_bridge(lua_State *L, void *data,
+                           const char *signature, mrp_funcbridge_value_t *args,
+                           char *ret_type, mrp_funcbridge_value_t *ret_val)
+{
+    mir_rtgroup_sortkey_t sortkey;
+    scripting_rtgroup *rtgs;
+    scripting_node *ns;
+    struct userdata *u;
+    mir_rtgroup *rtg;
+    mir_node *node;
+    bool success;
+
+    (void)L;
+
+    pa_assert(signature);
+    pa_assert(args);
+    pa_assert(ret_type);
+    pa_assert(ret_val);
+
+    pa_assert_se((sortkey = (mir_rtgroup_sortkey_t)data));
+
+    if (strcmp(signature, "oo"))
+        success = false;
+    else {
+        pa_assert_se((rtgs = args[0].pointer));
+        pa_assert_se((u = rtgs->userdata));
+        pa_assert_se((ns = args[1].pointer));
+
+        if (!(rtg = rtgs->rtg) || !(node = ns->node))
+            success = false;
+        else {
+            success = true;
+            *ret_type = MRP_FUNCBRIDGE_FLOATING;
+            ret_val->floating = sortkey(u, rtg, node);
+        }
+    }
+
+    return success;
+}
+
+
 static bool change_bridge(lua_State *L, void *data,
                           const char *signature, mrp_funcbridge_value_t *args,
                           char *ret_type, mrp_funcbridge_value_t *ret_val)
@@ -1748,6 +1996,7 @@ static int apclass_create(lua_State *L)
     map_t *binaries = NULL;
     pa_nodeset_resdef *resdef;
     map_t *r, *b;
+    uint32_t flags;
     size_t i;
     const char *n;
     bool ir, or;
@@ -1845,8 +2094,11 @@ static int apclass_create(lua_State *L)
     if (binaries) {
         for (b = binaries;  b->name;  b++) {
             resdef = b->needres ? &b->resource : NULL;
+            flags = b->launcher ? PA_NODESET_MAP_LAUNCHER : 0;
 
-            if (pa_nodeset_add_binary(u, b->name, type, b->role, resdef)) {
+            if (pa_nodeset_add_binary(u, b->name, type, b->role, resdef,
+                                      flags))
+            {
                 luaL_error(L, "binary '%s' is added to multiple application "
                            "classes", b->name);
             }
@@ -2114,6 +2366,7 @@ static int vollim_create(lua_State *L)
     intarray_t *classes = NULL;
     bool suppress = false;
     bool correct = false;
+    bool builtin = false;
     size_t arglgh = 0;
     int i;
     int class;
@@ -2155,6 +2408,7 @@ static int vollim_create(lua_State *L)
         luaL_error(L, "missing calculate field");
     if (type != vollim_maximum) {
         if (calculate->type == MRP_C_FUNCTION) {
+            builtin = true;
             if (strcmp(calculate->c.signature, "odod"))
                 luaL_error(L,"invalid calculate field (mismatching signature)");
             if (calculate->c.data == mir_volume_suppress) {
@@ -2256,9 +2510,17 @@ static int vollim_create(lua_State *L)
 
     switch (type) {
     case vollim_generic:
-        mir_volume_add_generic_limit(u, vollim_calculate, vlim->args);
+        if (builtin)
+            mir_volume_add_correction_limit(u, (double **)(void *)vlim->args);
+        else
+            mir_volume_add_generic_limit(u, vollim_calculate, vlim->args);
         break;
     case vollim_class:
+        if (builtin) {
+            mir_volume_add_suppress_limit(u, classes->nint, classes->ints,
+                                (mir_volume_suppress_arg *)(void *)vlim->args);
+            break;
+        }
         for (i = 0;  i < (int)(classes->nint);  i++) {
             mir_volume_add_class_limit(u, classes->ints[i], vollim_calculate,
                                        vlim->args);
@@ -2715,7 +2977,10 @@ static map_t *map_check(lua_State *L, int tbl)
 
         case LUA_TSTRING:
             m->needres = false;
-            m->role = mrp_strdup(lua_tostring(L, def));
+            if (pa_streq(lua_tostring(L, def), "launcher"))
+                m->launcher = true;
+            else
+                m->role = mrp_strdup(lua_tostring(L, def));
             break;
 
         case LUA_TTABLE:
@@ -2748,6 +3013,8 @@ static map_t *map_check(lua_State *L, int tbl)
                         rd->flags.audio |= RESPROTO_RESFLAG_MANDATORY;
                     else if (pa_streq(option, "shared"))
                         rd->flags.audio |= RESPROTO_RESFLAG_SHARED;
+                    else if (pa_streq(option, "launcher"))
+                        m->launcher = true;
                     else if (!pa_streq(option, "optional") &&
                              !pa_streq(option, "exclusive") )
                     {
@@ -2788,6 +3055,8 @@ static int map_push(lua_State *L, map_t *map)
             if (!m->needres) {
                 if (m->role)
                     lua_pushstring(L, m->role);
+                else if (m->launcher)
+                    lua_pushstring(L, "launcher");
                 else
                     lua_pushnumber(L, 0);
             }
@@ -2959,6 +3228,10 @@ static field_t field_name_to_type(const char *name, size_t len)
             if (!strcmp(name, "priority"))
                 return PRIORITY;
             break;
+        case 's':
+            if (!strcmp(name, "sort_key"))
+                return SORT_KEY;
+            break;
         default:
             break;
         }
@@ -3224,6 +3497,8 @@ static bool register_methods(lua_State *L)
         {"compare_default","ooo" , compare_bridge  ,mir_router_default_compare},
         {"accept_phone"   ,"oo"  , accept_bridge   ,mir_router_phone_accept   },
         {"compare_phone"  ,"ooo" , compare_bridge  ,mir_router_phone_compare  },
+        {"sort_key_default","oo" , sortkey_bridge  ,mir_router_default_sortkey},
+        {"sort_key_phone" ,"oo"  , sortkey_bridge  ,mir_router_phone_sortkey  },
         {"volume_supress" ,"odod", calculate_bridge,mir_volume_suppress       },
         {"volume_correct" ,"odod", calculate_bridge,mir_volume_correction     },
         {"change_volume_context","o",change_bridge, mir_volume_change_context },
@@ -31,6 +31,9 @@ bool pa_scripting_dofile(struct userdata *, const char *);
 scripting_node *pa_scripting_node_create(struct userdata *, mir_node *);
 void pa_scripting_node_destroy(struct userdata *, mir_node *);
 
+void pa_scripting_accept_rtgroups(struct userdata *, mir_node *,
+                                  mir_rtgroup **, size_t, uint32_t *);
+
 #endif /* fooscriptingfoo */
 
 /*
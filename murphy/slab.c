@@ -0,0 +1,294 @@
+/*
+ * module-murphy-ivi -- PulseAudio module for providing audio routing support
+ * Copyright (c) 2012, Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St - Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pulsecore/pulsecore-config.h>
+
+#include <pulse/xmalloc.h>
+#include <pulse/proplist.h>
+#include <pulsecore/log.h>
+
+#include "slab.h"
+#include "node.h"
+#include "router.h"
+#include "constrain.h"
+
+#define SLAB_ALIGN        16
+#define SLAB_ROUND(s)     (((s) + SLAB_ALIGN - 1) & ~((size_t)SLAB_ALIGN - 1))
+#define SLAB_CHUNK_SIZE   4096
+#define SLAB_CHUNK_MIN    8
+
+typedef struct slab_chunk  slab_chunk;
+typedef struct slab_object slab_object;
+
+struct slab_chunk {
+    slab_chunk    *next;      /**< chunks of the same slab */
+};
+
+struct slab_object {
+    slab_object   *next;      /**< next free object of the same slab */
+};
+
+typedef struct {
+    const char    *name;
+    slab_chunk    *chunks;    /**< every chunk ever allocated */
+    slab_object   *free;      /**< free objects, most recently freed first */
+    pa_slab_stats  stats;
+} pa_slab;
+
+struct pa_slabset {
+    pa_slab        slabs[PA_SLAB_MAX];
+};
+
+static void slab_init(pa_slab *, const char *, size_t);
+static void slab_done(pa_slab *);
+static void slab_grow(pa_slab *);
+
+
+pa_slabset *pa_slabset_init(struct userdata *u)
+{
+    pa_slabset *slabset;
+
+    pa_assert(u);
+
+    slabset = pa_xnew0(pa_slabset, 1);
+
+    slab_init(slabset->slabs + PA_SLAB_NODE, "node", sizeof(mir_node));
+    slab_init(slabset->slabs + PA_SLAB_RTENTRY, "rtentry",
+              sizeof(mir_rtentry));
+    slab_init(slabset->slabs + PA_SLAB_CONSTR_LINK, "constr_link",
+              sizeof(mir_constr_link));
+    slab_init(slabset->slabs + PA_SLAB_CONNECTION, "connection",
+              sizeof(mir_connection));
+
+    return slabset;
+}
+
+void pa_slabset_done(struct userdata *u)
+{
+    pa_slabset *slabset;
+    char buf[1024];
+    int i;
+
+    if (u && (slabset = u->slabs)) {
+        pa_slabset_print_stats(u, buf, sizeof(buf));
+        pa_log_debug("%s", buf);
+
+        for (i = 0;  i < PA_SLAB_MAX;  i++)
+            slab_done(slabset->slabs + i);
+
+        pa_xfree(slabset);
+
+        u->slabs = NULL;
+    }
+}
+
+void *pa_slab_alloc(struct userdata *u, pa_slab_type type)
+{
+    pa_slabset *slabset;
+    pa_slab *slab;
+    slab_object *obj;
+
+    pa_assert(u);
+    pa_assert(type >= 0 && type < PA_SLAB_MAX);
+    pa_assert_se((slabset = u->slabs));
+
+    slab = slabset->slabs + type;
+
+    if (!slab->free)
+        slab_grow(slab);
+
+    pa_assert_se((obj = slab->free));
+
+    slab->free = obj->next;
+
+    memset(obj, 0, slab->stats.size);
+
+    slab->stats.nalloc++;
+
+    if (++slab->stats.nlive > slab->stats.maxlive)
+        slab->stats.maxlive = slab->stats.nlive;
+
+    return obj;
+}
+
+void pa_slab_free(struct userdata *u, pa_slab_type type, void *ptr)
+{
+    pa_slabset *slabset;
+    pa_slab *slab;
+    slab_object *obj;
+
+    pa_assert(u);
+    pa_assert(type >= 0 && type < PA_SLAB_MAX);
+    pa_assert_se((slabset = u->slabs));
+
+    if ((obj = ptr)) {
+        slab = slabset->slabs + type;
+
+        pa_assert(slab->stats.nlive > 0);
+
+        obj->next  = slab->free;
+        slab->free = obj;
+
+        slab->stats.nlive--;
+    }
+}
+
+void pa_slabset_publish_stats(struct userdata *u, pa_proplist *pl)
+{
+    pa_slabset *slabset;
+    pa_slab *slab;
+    char key[64];
+    int i;
+
+    pa_assert(u);
+    pa_assert(pl);
+
+    if (!(slabset = u->slabs))
+        return;
+
+    for (i = 0;  i < PA_SLAB_MAX;  i++) {
+        slab = slabset->slabs + i;
+
+        snprintf(key, sizeof(key), "%s.slab.%s.live", PA_PROP_STATS,
+                 slab->name);
+        pa_proplist_setf(pl, key, "%u", slab->stats.nlive);
+
+        snprintf(key, sizeof(key), "%s.slab.%s.max", PA_PROP_STATS,
+                 slab->name);
+        pa_proplist_setf(pl, key, "%u", slab->stats.maxlive);
+
+        snprintf(key, sizeof(key), "%s.slab.%s.chunks", PA_PROP_STATS,
+                 slab->name);
+        pa_proplist_setf(pl, key, "%u", slab->stats.nchunk);
+    }
+}
+
+int pa_slabset_print_stats(struct userdata *u, char *buf, int len)
+{
+    pa_slabset *slabset;
+    pa_slab *slab;
+    char *p, *e;
+    int i;
+
+    pa_assert(u);
+    pa_assert(buf);
+    pa_assert(len > 0);
+    pa_assert_se((slabset = u->slabs));
+
+    e = (p = buf) + len;
+    *p = 0;
+
+    if (p < e)
+        p += snprintf(p, (size_t)(e-p), "slabs:\n");
+
+    for (i = 0;  i < PA_SLAB_MAX && p < e;  i++) {
+        slab = slabset->slabs + i;
+
+        p += snprintf(p, (size_t)(e-p), "   %-12s %u live, %u max, "
+                      "%u allocations, %u chunks of %zu x %zu bytes\n",
+                      slab->name, slab->stats.nlive, slab->stats.maxlive,
+                      slab->stats.nalloc, slab->stats.nchunk,
+                      slab->stats.perchunk, slab->stats.size);
+    }
+
+    return p - buf;
+}
+
+
+static void slab_init(pa_slab *slab, const char *name, size_t size)
+{
+    size_t perchunk;
+
+    pa_assert(slab);
+    pa_assert(name);
+
+    size = SLAB_ROUND(size < sizeof(slab_object) ? sizeof(slab_object) : size);
+    perchunk = (SLAB_CHUNK_SIZE - SLAB_ROUND(sizeof(slab_chunk))) / size;
+
+    if (perchunk < SLAB_CHUNK_MIN)
+        perchunk = SLAB_CHUNK_MIN;
+
+    slab->name = name;
+    slab->stats.size = size;
+    slab->stats.perchunk = perchunk;
+}
+
+static void slab_done(pa_slab *slab)
+{
+    slab_chunk *chunk, *next;
+
+    pa_assert(slab);
+
+    if (slab->stats.nlive) {
+        pa_log_info("%u %s object(s) were not freed",
+                    slab->stats.nlive, slab->name);
+    }
+
+    for (chunk = slab->chunks;  chunk;  chunk = next) {
+        next = chunk->next;
+        pa_xfree(chunk);
+    }
+
+    slab->chunks = NULL;
+    slab->free = NULL;
+}
+
+static void slab_grow(pa_slab *slab)
+{
+    slab_chunk *chunk;
+    slab_object *obj;
+    char *base;
+    size_t size;
+    size_t i;
+
+    pa_assert(slab);
+
+    size = slab->stats.size;
+
+    chunk = pa_xmalloc(SLAB_ROUND(sizeof(slab_chunk)) +
+                       size * slab->stats.perchunk);
+    chunk->next = slab->chunks;
+    slab->chunks = chunk;
+    slab->stats.nchunk++;
+
+    base = (char *)chunk + SLAB_ROUND(sizeof(slab_chunk));
+
+    /*
+     * thread the objects backwards, so that a freshly grown chunk is
+     * handed out in address order and related objects stay adjacent
+     */
+    for (i = slab->stats.perchunk;  i > 0;  i--) {
+        obj = (slab_object *)(base + (i - 1) * size);
+        obj->next = slab->free;
+        slab->free = obj;
+    }
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
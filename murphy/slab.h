@@ -0,0 +1,62 @@
+/*
+ * module-murphy-ivi -- PulseAudio module for providing audio routing support
+ * Copyright (c) 2012, Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St - Fifth Floor, Boston,
+ * MA 02110-1301 USA.
+ *
+ */
+#ifndef foomirslabfoo
+#define foomirslabfoo
+
+#include <sys/types.h>
+
+#include "userdata.h"
+
+typedef enum {
+    PA_SLAB_NODE = 0,        /**< mir_node */
+    PA_SLAB_RTENTRY,         /**< mir_rtentry */
+    PA_SLAB_CONSTR_LINK,     /**< mir_constr_link */
+    PA_SLAB_CONNECTION,      /**< mir_connection */
+    PA_SLAB_MAX
+} pa_slab_type;
+
+typedef struct {
+    uint32_t   nlive;        /**< objects currently in use */
+    uint32_t   maxlive;      /**< high-water mark of nlive */
+    uint32_t   nalloc;       /**< total number of allocations */
+    uint32_t   nchunk;       /**< chunks allocated from the heap */
+    size_t     size;         /**< bytes per object, after alignment */
+    size_t     perchunk;     /**< objects per chunk */
+} pa_slab_stats;
+
+pa_slabset *pa_slabset_init(struct userdata *);
+void pa_slabset_done(struct userdata *);
+
+void *pa_slab_alloc(struct userdata *, pa_slab_type);
+void pa_slab_free(struct userdata *, pa_slab_type, void *);
+
+void pa_slabset_publish_stats(struct userdata *, pa_proplist *);
+int pa_slabset_print_stats(struct userdata *, char *, int);
+
+#endif  /* foomirslabfoo */
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
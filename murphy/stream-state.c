@@ -43,19 +43,32 @@ bool pa_stream_state_start_corked(struct userdata *u,
                                        pa_nodeset_resdef *resdef)
 {
     if (resdef) {
-        if (pa_streq(data->driver, scache_driver)) {
-            pa_assert((data->flags & flag_mask) == flag_mask);
-        }
-
-        data->flags &= ~flag_mask;
-        data->flags |= PA_SINK_INPUT_START_CORKED;
-
+        pa_stream_state_hold(u, data);
         return true;
     }
 
     return false;
 }
 
+void pa_stream_state_hold(struct userdata *u, pa_sink_input_new_data *data)
+{
+    if (pa_streq(data->driver, scache_driver)) {
+        pa_assert((data->flags & flag_mask) == flag_mask);
+    }
+
+    data->flags &= ~flag_mask;
+    data->flags |= PA_SINK_INPUT_START_CORKED;
+}
+
+void pa_stream_state_release(struct userdata *u, pa_sink_input *sinp)
+{
+    pa_assert(u);
+    pa_assert(sinp);
+
+    /* for streams held with no node to enforce the policies on */
+    sink_input_block(u, sinp, false);
+}
+
 void pa_stream_state_change(struct userdata *u, mir_node *node, int req)
 {
     pa_loopnode *loop;
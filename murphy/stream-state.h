@@ -32,6 +32,8 @@
 bool pa_stream_state_start_corked(struct userdata *,
                                        pa_sink_input_new_data *,
                                        pa_nodeset_resdef *);
+void pa_stream_state_hold(struct userdata *, pa_sink_input_new_data *);
+void pa_stream_state_release(struct userdata *, pa_sink_input *);
 void pa_stream_state_change(struct userdata *u, mir_node *, int);
 
 
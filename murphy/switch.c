@@ -61,6 +61,9 @@ static pa_sink   *setup_device_output(struct userdata *, mir_node *);
 static bool set_profile(struct userdata *, mir_node *);
 static bool set_port(struct userdata *, mir_node *);
 
+static bool device_is_set_up(struct userdata *, mir_node *);
+static bool muxed_stream_goes_to(struct userdata *, pa_muxnode *, pa_sink *);
+
 
 bool mir_switch_setup_link(struct userdata *u,
                                 mir_node *from,
@@ -236,6 +239,56 @@ bool mir_switch_teardown_link(struct userdata *u,
     return true;
 }
 
+bool mir_switch_default_link_exists(struct userdata *u,
+                                    mir_node        *from,
+                                    mir_node        *to)
+{
+    pa_core          *core;
+    pa_sink          *sink;
+    pa_sink_input    *sinp;
+    pa_source        *source;
+    pa_source_output *sout;
+
+    pa_assert(u);
+    pa_assert(from);
+    pa_assert(to);
+    pa_assert_se((core = u->core));
+
+    if (to->implement == mir_stream) {
+        /* device -> stream */
+        if (from->implement != mir_device || !device_is_set_up(u, from))
+            return false;
+
+        if (!(source = pa_idxset_get_by_index(core->sources, from->paidx)) ||
+            !(sout = pa_idxset_get_by_index(core->source_outputs, to->paidx)))
+            return false;
+
+        return sout->source == source;
+    }
+
+    if (!device_is_set_up(u, to) ||
+        !(sink = pa_idxset_get_by_index(core->sinks, to->paidx)))
+        return false;
+
+    if (from->mux)
+        return muxed_stream_goes_to(u, from->mux, sink);
+
+    if (from->implement == mir_stream) {
+        /* stream -> device */
+        sinp = pa_idxset_get_by_index(core->sink_inputs, from->paidx);
+    }
+    else {
+        /* looped back device -> device */
+        if (!from->loop)
+            return false;
+
+        sinp = pa_idxset_get_by_index(core->sink_inputs,
+                                      from->loop->sink_input_index);
+    }
+
+    return sinp && sinp->sink == sink;
+}
+
 static bool setup_explicit_stream2dev_link(struct userdata *u,
                                                 mir_node *from,
                                                 mir_node *to)
@@ -264,6 +317,9 @@ static bool setup_explicit_stream2dev_link(struct userdata *u,
         if (sinp && sinp->sink == sink) {
             if (!pa_multiplex_remove_default_route(core, mux, true))
                 return false;
+
+            /* the routing method property of sinp has been changed */
+            pa_discover_invalidate_stream_meta(u, sinp);
         }
         else if (pa_multiplex_duplicate_route(core, mux, NULL, sink)) {
             pa_log_debug("multiplex route %s => %s already exists",
@@ -654,6 +710,70 @@ static pa_sink *setup_device_output(struct userdata *u, mir_node *node)
 }
 
 
+static bool device_is_set_up(struct userdata *u, mir_node *node)
+{
+    pa_core         *core;
+    pa_card         *card;
+    pa_card_profile *prof;
+    pa_sink         *sink;
+    pa_source       *source;
+    pa_device_port  *port;
+
+    pa_assert(u);
+    pa_assert(node);
+    pa_assert_se((core = u->core));
+
+    if (node->paidx == PA_IDXSET_INVALID)
+        return false;
+
+    if (node->type == mir_bluetooth_a2dp || node->type == mir_bluetooth_sco) {
+        if (!(card = pa_idxset_get_by_index(core->cards, node->pacard.index)) ||
+            !(prof = card->active_profile) ||
+            !pa_streq(node->pacard.profile, prof->name))
+            return false;
+    }
+
+    if (node->paport) {
+        if (node->direction == mir_input) {
+            if (!(source = pa_idxset_get_by_index(core->sources, node->paidx)))
+                return false;
+            port = source->active_port;
+        }
+        else {
+            if (!(sink = pa_idxset_get_by_index(core->sinks, node->paidx)))
+                return false;
+            port = sink->active_port;
+        }
+
+        if (!port || !pa_streq(node->paport, port->name))
+            return false;
+    }
+
+    return true;
+}
+
+static bool muxed_stream_goes_to(struct userdata *u,
+                                 pa_muxnode      *mux,
+                                 pa_sink         *sink)
+{
+    pa_core       *core;
+    pa_sink_input *sinp;
+
+    pa_assert(u);
+    pa_assert(mux);
+    pa_assert(sink);
+    pa_assert_se((core = u->core));
+
+    if (mux->defstream_index == PA_IDXSET_INVALID)
+        return false;
+
+    if (!(sinp = pa_idxset_get_by_index(core->sink_inputs,
+                                        mux->defstream_index)))
+        return false;
+
+    return sinp->sink == sink;
+}
+
 static bool set_profile(struct userdata *u, mir_node *node)
 {
     pa_core         *core;
@@ -763,10 +883,13 @@ static bool set_port(struct userdata *u, mir_node *node)
         paidx = sink->index;
     }
 
-    if ((oldnode = pa_discover_remove_node_from_ptr_hash(u, data)))
+    if ((oldnode = pa_discover_remove_node_from_ptr_hash(u, data))) {
         oldnode->paidx = PA_IDXSET_INVALID;
+        mir_node_update_hot(u, oldnode);
+    }
 
     node->paidx = paidx;
+    mir_node_update_hot(u, node);
     pa_discover_add_node_to_ptr_hash(u, data, node);
 
 
@@ -28,6 +28,8 @@
 bool mir_switch_setup_link(struct userdata *, mir_node *, mir_node *,
                                 bool);
 bool mir_switch_teardown_link(struct userdata *, mir_node *, mir_node *);
+bool mir_switch_default_link_exists(struct userdata *, mir_node *,
+                                    mir_node *);
 
 
 #endif  /* foomirswitchfoo */
@@ -28,6 +28,7 @@
 #include "discover.h"
 #include "router.h"
 #include "node.h"
+#include "scheduler.h"
 
 
 struct pa_card_hooks {
@@ -56,6 +57,7 @@ struct pa_sink_input_hooks {
     pa_hook_slot    *neew;
     pa_hook_slot    *put;
     pa_hook_slot    *unlink;
+    pa_hook_slot    *plchg;
 };
 
 struct pa_source_output_hooks {
@@ -92,6 +94,7 @@ static pa_hook_result_t source_port_changed(void *, void *, void *);
 static pa_hook_result_t sink_input_new(void *, void *, void *);
 static pa_hook_result_t sink_input_put(void *, void *, void *);
 static pa_hook_result_t sink_input_unlink(void *, void *, void *);
+static pa_hook_result_t sink_input_proplist_changed(void *, void *, void *);
 
 static pa_hook_result_t source_output_new(void *, void *, void *);
 static pa_hook_result_t source_output_put(void *, void *, void *);
@@ -179,6 +182,10 @@ pa_tracker *pa_tracker_init(struct userdata *u)
                        hooks + PA_CORE_HOOK_SINK_INPUT_UNLINK,
                        PA_HOOK_LATE, sink_input_unlink, u
                    );
+    sinp->plchg  = pa_hook_connect(
+                       hooks + PA_CORE_HOOK_SINK_INPUT_PROPLIST_CHANGED,
+                       PA_HOOK_LATE, sink_input_proplist_changed, u
+                   );
     
     /* source-output */
     sout->neew   = pa_hook_connect(
@@ -230,6 +237,7 @@ void pa_tracker_done(struct userdata *u)
         pa_hook_slot_free(sinp->neew);
         pa_hook_slot_free(sinp->put);
         pa_hook_slot_free(sinp->unlink);
+        pa_hook_slot_free(sinp->plchg);
 
         pa_xfree(tracker);
         
@@ -256,10 +264,12 @@ void pa_tracker_synchronize(struct userdata *u)
     }
 
     PA_IDXSET_FOREACH(sink, core->sinks, index) {
+        pa_discover_card_link_device(u, mir_output, sink);
         pa_discover_add_sink(u, sink, false);
     }
 
     PA_IDXSET_FOREACH(source, core->sources, index) {
+        pa_discover_card_link_device(u, mir_input, source);
         pa_discover_add_source(u, source);
     }
 
@@ -276,7 +286,8 @@ void pa_tracker_synchronize(struct userdata *u)
         pa_discover_register_source_output(u, sout);
     }
 
-    mir_router_make_routing(u);
+    /* in bulk mode this is the single pass at the end of the load */
+    pa_scheduler_request(u, PA_SCHEDULER_ALL);
 }
 
 
@@ -311,7 +322,7 @@ static pa_hook_result_t card_unlink(void *hook_data,
     mir_router_print_rtgroups(u, buf, sizeof(buf));
     pa_log_debug("%s", buf);
 
-    mir_router_make_routing(u);
+    pa_scheduler_request(u, PA_SCHEDULER_ROUTING);
 
     return PA_HOOK_OK;
 }
@@ -360,6 +371,7 @@ static pa_hook_result_t sink_put(void *hook_data,
     pa_assert(u);
     pa_assert(sink);
 
+    pa_discover_card_link_device(u, mir_output, sink);
     pa_discover_add_sink(u, sink, true);
 
     return PA_HOOK_OK;
@@ -377,6 +389,7 @@ static pa_hook_result_t sink_unlink(void *hook_data,
     pa_assert(sink);
 
     pa_discover_remove_sink(u, sink);
+    pa_discover_card_unlink_device(u, mir_output, sink);
 
     return PA_HOOK_OK;
 }
@@ -407,6 +420,7 @@ static pa_hook_result_t source_put(void *hook_data,
     pa_assert(u);
     pa_assert(source);
 
+    pa_discover_card_link_device(u, mir_input, source);
     pa_discover_add_source(u, source);
 
     return PA_HOOK_OK;
@@ -424,6 +438,7 @@ static pa_hook_result_t source_unlink(void *hook_data,
     pa_assert(source);
 
     pa_discover_remove_source(u, source);
+    pa_discover_card_unlink_device(u, mir_input, source);
 
     return PA_HOOK_OK;
 }
@@ -491,6 +506,21 @@ static pa_hook_result_t sink_input_unlink(void *hook_data,
     return PA_HOOK_OK;
 }
 
+static pa_hook_result_t sink_input_proplist_changed(void *hook_data,
+                                                    void *call_data,
+                                                    void *slot_data)
+{
+    struct pa_sink_input *sinp = (pa_sink_input *)call_data;
+    struct userdata *u = (struct userdata *)slot_data;
+
+    pa_assert(u);
+    pa_assert(sinp);
+
+    pa_discover_invalidate_stream_meta(u, sinp);
+
+    return PA_HOOK_OK;
+}
+
 
 static pa_hook_result_t source_output_new(void *hook_data,
                                           void *call_data,
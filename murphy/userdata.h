@@ -41,8 +41,10 @@
 #define PA_PROP_ENV_ZONE               PA_PROP_PROCESS_ENVIRONMENT ".AUDIO_ZONE"
 #define PA_PROP_ROUTING_CLASS_NAME     "routing.class.name"
 #define PA_PROP_ROUTING_CLASS_ID       "routing.class.id"
+#define PA_PROP_ROUTING_PROVISIONAL    "routing.class.provisional"
 #define PA_PROP_ROUTING_METHOD         "routing.method"
 #define PA_PROP_ROUTING_TABLE          "routing.table"
+#define PA_PROP_STATS                  "murphy.stats"
 #define PA_PROP_NODE_INDEX             "node.index"
 #define PA_PROP_NODE_TYPE              "node.type"
 #define PA_PROP_NODE_ROLE              "node.role"
@@ -72,6 +74,10 @@ typedef struct pa_discover              pa_discover;
 typedef struct pa_router                pa_router;
 typedef struct pa_constrain             pa_constrain;
 typedef struct pa_fader                 pa_fader;
+typedef struct pa_scheduler             pa_scheduler;
+typedef struct pa_slabset               pa_slabset;
+typedef struct pa_atomset               pa_atomset;
+typedef struct pa_pidcache              pa_pidcache;
 typedef struct pa_scripting             pa_scripting;
 typedef struct pa_mir_volume            pa_mir_volume;
 typedef struct pa_mir_config            pa_mir_config;
@@ -100,6 +106,7 @@ typedef struct pa_resource_stream_entry  pa_resource_stream_entry;
 //typedef enum   mir_node_type            mir_node_type;
 //typedef enum   mir_privacy              mir_privacy; 
 typedef struct mir_node                 mir_node;
+typedef struct mir_node_hot             mir_node_hot;
 typedef struct mir_zone                 mir_zone;
 typedef struct mir_rtgroup              mir_rtgroup;
 typedef struct mir_rtentry              mir_rtentry;
@@ -107,6 +114,7 @@ typedef struct mir_connection           mir_connection;
 typedef struct mir_constr_link          mir_constr_link;
 typedef struct mir_constr_def           mir_constr_def;
 typedef struct mir_vlim                 mir_vlim;
+typedef struct mir_stream_meta          mir_stream_meta;
 typedef struct mir_volume_suppress_arg  mir_volume_suppress_arg;
 
 typedef struct scripting_import         scripting_import;
@@ -125,10 +133,10 @@ typedef struct am_ack_data              am_ack_data;
 typedef struct am_connect_data          am_connect_data;
 
 typedef struct {
-    char *profile;    /**< During profile change it contains the new profile
-                           name. Otherwise it is NULL. When sink tracking
-                           hooks called the card's active_profile still
-                           points to the old profile */
+    const char *profile; /**< During profile change it contains the new
+                              profile name. Otherwise it is NULL. When sink
+                              tracking hooks called the card's active_profile
+                              still points to the old profile */
     uint32_t sink;
     uint32_t source;
 } pa_mir_state;
@@ -249,6 +257,10 @@ struct userdata {
     pa_native_protocol *protocol;
     pa_murphyif   *murphyif;
     pa_resource   *resource;
+    pa_scheduler  *scheduler;
+    pa_slabset    *slabs;
+    pa_atomset    *atoms;
+    pa_pidcache   *pidcache;
     bool           enable_multiplex;
 };
 
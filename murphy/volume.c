@@ -34,12 +34,16 @@
 #include "fader.h"
 #include "node.h"
 #include "resource.h"
+#include "discover.h"
 #include "utils.h"
 
 #define VLIM_CLASS_ALLOC_BUCKET  16
+#define VLIM_MEMO_SIZE           256     /* must be power of 2 */
 
 typedef struct vlim_entry  vlim_entry;
 typedef struct vlim_table  vlim_table;
+typedef struct vlim_memo   vlim_memo;
+typedef struct vlim_suppress  vlim_suppress;
 
 
 struct vlim_entry {
@@ -52,11 +56,35 @@ struct vlim_table {
     vlim_entry  *entries;
 };
 
+struct vlim_suppress {
+    uint32_t     classes;        /**< mask of the suppressed classes */
+    uint32_t     trigger;        /**< mask of the triggering classes */
+    double      *attenuation;
+};
+
+struct vlim_memo {
+    uint32_t     gen;            /**< valid if equals to the current gen. */
+    uint32_t     node;           /**< device node index */
+    uint32_t     mask;           /**< active class mask */
+    int          class;
+    double       attenuation;
+};
+
 struct pa_mir_volume {
     int          classlen;       /**< class table length  */
     vlim_table  *classlim;       /**< class indexed table */
     vlim_table   genlim;         /**< generic limit */
     double       maxlim[mir_application_class_end];  /**< per class max. limit */
+    struct {
+        size_t          nsuppress;
+        vlim_suppress  *suppress;
+        size_t          ncorrect;
+        double       ***correct; /**< see mir_volume_correction() */
+    }            builtin;        /**< natively evaluated builtin limits */
+    struct {
+        uint32_t     gen;        /**< bumped to invalidate all entries */
+        vlim_memo    entries[VLIM_MEMO_SIZE];
+    }            memo;           /**< direct mapped cache of apply_limits() */
     pa_main_volume_policy *main_volume_policy;
 };
 
@@ -66,6 +94,12 @@ static void destroy_table(vlim_table *);
 static double apply_table(double, vlim_table *, struct userdata *, int,
                           mir_node *, uint32_t, const char *);
 
+static vlim_table *get_class_table(pa_mir_volume *, int);
+static double apply_suppressions(double, pa_mir_volume *, int,
+                                 mir_node *, uint32_t);
+static double apply_corrections(double, pa_mir_volume *, mir_node *);
+static vlim_memo *memo_slot(pa_mir_volume *, mir_node *, uint32_t, int);
+
 static void reset_volume_limit(struct userdata *, mir_node *, uint32_t);
 static void add_volume_limit(struct userdata *, mir_node *, int);
 
@@ -80,6 +114,8 @@ pa_mir_volume *pa_mir_volume_init(struct userdata *u)
     for (i = 0;  i < mir_application_class_end;  i++)
         volume->maxlim[i] = MIR_VOLUME_MAX_ATTENUATION;
 
+    volume->memo.gen = 1;
+
     volume->main_volume_policy = pa_main_volume_policy_get(u->core);
 
     return volume;
@@ -101,6 +137,9 @@ void pa_mir_volume_done(struct userdata *u)
 
         destroy_table(&volume->genlim);
 
+        pa_xfree(volume->builtin.suppress);
+        pa_xfree(volume->builtin.correct);
+
         pa_xfree(volume);
 
         u->volume = NULL;
@@ -113,35 +152,68 @@ void mir_volume_add_class_limit(struct userdata  *u,
                                 void             *arg)
 {
     pa_mir_volume *volume;
-    vlim_table    *classlim;
     vlim_table    *table;
-    size_t         newlen;
-    size_t         size;
-    size_t         diff;
 
     pa_assert(u);
     pa_assert(func);
     pa_assert(class > 0);
     pa_assert_se((volume = u->volume));
 
-    if (class < volume->classlen)
-        table = volume->classlim + class;
-    else {
-        newlen = (size_t)(class + 1);
-        size = sizeof(vlim_table) * newlen;
-        diff = sizeof(vlim_table) * (newlen - (size_t)volume->classlen);
+    table = get_class_table(volume, class);
+
+    add_to_table(table, func, arg);
 
-        pa_assert_se((classlim = realloc(volume->classlim, size)));
-        memset(classlim + volume->classlen, 0, diff);
+    mir_volume_invalidate_limits(u);
+}
 
+void mir_volume_add_suppress_limit(struct userdata         *u,
+                                   size_t                   nclass,
+                                   int                     *classes,
+                                   mir_volume_suppress_arg *arg)
+{
+    pa_mir_volume *volume;
+    vlim_suppress *entry;
+    uint32_t       clmask;
+    size_t         size;
+    size_t         i;
 
-        volume->classlen = (int)newlen;
-        volume->classlim = classlim;
+    pa_assert(u);
+    pa_assert(classes || !nclass);
+    pa_assert(arg);
+    pa_assert_se((volume = u->volume));
 
-        table = classlim + class;
+    for (i = 0, clmask = 0;  i < nclass;  i++) {
+        /* keeps the class table length as if this were a class limit */
+        get_class_table(volume, classes[i]);
+        clmask |= mir_volume_get_class_mask(classes[i]);
     }
 
-    add_to_table(table, func, arg);
+    size = sizeof(vlim_suppress) * (volume->builtin.nsuppress + 1);
+    volume->builtin.suppress = pa_xrealloc(volume->builtin.suppress, size);
+
+    entry = volume->builtin.suppress + volume->builtin.nsuppress++;
+    entry->classes = clmask;
+    entry->trigger = arg->trigger.clmask;
+    entry->attenuation = arg->attenuation;
+
+    mir_volume_invalidate_limits(u);
+}
+
+void mir_volume_add_correction_limit(struct userdata *u, double **arg)
+{
+    pa_mir_volume *volume;
+    size_t         size;
+
+    pa_assert(u);
+    pa_assert(arg);
+    pa_assert_se((volume = u->volume));
+
+    size = sizeof(double **) * (volume->builtin.ncorrect + 1);
+    volume->builtin.correct = pa_xrealloc(volume->builtin.correct, size);
+
+    volume->builtin.correct[volume->builtin.ncorrect++] = arg;
+
+    mir_volume_invalidate_limits(u);
 }
 
 
@@ -156,6 +228,8 @@ void mir_volume_add_generic_limit(struct userdata  *u,
     pa_assert_se((volume = u->volume));
 
     add_to_table(&volume->genlim, func, arg);
+
+    mir_volume_invalidate_limits(u);
 }
 
 
@@ -175,6 +249,22 @@ void mir_volume_add_maximum_limit(struct userdata *u,
         if ((class = classes[i]) < mir_application_class_end)
             volume->maxlim[class] = maxlim;
     }
+
+    mir_volume_invalidate_limits(u);
+}
+
+void mir_volume_invalidate_limits(struct userdata *u)
+{
+    pa_mir_volume *volume;
+
+    pa_assert(u);
+    pa_assert_se((volume = u->volume));
+
+    if (!++volume->memo.gen) {
+        /* wrapped around: stale entries could look valid again */
+        memset(volume->memo.entries, 0, sizeof(volume->memo.entries));
+        volume->memo.gen = 1;
+    }
 }
 
 
@@ -186,6 +276,7 @@ void mir_volume_make_limiting(struct userdata *u)
 
     stamp = pa_utils_new_stamp();
 
+    mir_volume_invalidate_limits(u);
     pa_fader_apply_volume_limits(u, stamp);
 }
 
@@ -218,20 +309,33 @@ double mir_volume_apply_limits(struct userdata *u,
     double devlim, classlim;
     vlim_table *tbl;
     double maxlim;
+    vlim_memo *memo;
 
     pa_assert(u);
     pa_assert_se((volume = u->volume));
 
+    if ((memo = memo_slot(volume, node, mask, class))) {
+        if (memo->gen == volume->memo.gen && memo->node == node->index &&
+            memo->mask == mask && memo->class == class)
+        {
+            pa_log_debug("        limit = %.2lf (memoized)",
+                         memo->attenuation);
+            return memo->attenuation;
+        }
+    }
+
     if (class < 0 || class >= volume->classlen) {
         if (class < 0 || class >= mir_application_class_end)
             attenuation = maxlim = MIR_VOLUME_MAX_ATTENUATION;
         else {
             attenuation = apply_table(0.0, &volume->genlim,
                                       u,class,node,mask, "device");
+            attenuation = apply_corrections(attenuation, volume, node);
         }
     }
     else {
         devlim = apply_table(0.0, &volume->genlim, u,class,node,mask, "device");
+        devlim = apply_corrections(devlim, volume, node);
         classlim = 0.0;
 
         if (class && node) {
@@ -243,6 +347,8 @@ double mir_volume_apply_limits(struct userdata *u,
             if (class < volume->classlen && (tbl = volume->classlim + class))
                 classlim = apply_table(classlim, tbl, u,class,node,mask, "class");
 
+            classlim = apply_suppressions(classlim, volume, class, node, mask);
+
             if (classlim <= MIR_VOLUME_MAX_ATTENUATION)
                 classlim = MIR_VOLUME_MAX_ATTENUATION;
             else if (classlim < maxlim)
@@ -252,6 +358,14 @@ double mir_volume_apply_limits(struct userdata *u,
         attenuation = devlim + classlim;
     }
 
+    if (memo) {
+        memo->gen = volume->memo.gen;
+        memo->node = node->index;
+        memo->mask = mask;
+        memo->class = class;
+        memo->attenuation = attenuation;
+    }
+
     return attenuation;
 }
 
@@ -338,6 +452,121 @@ void mir_volume_change_context(struct userdata *u, const char *volume_class)
     /* TODO: change volume class here */
 }
 
+static vlim_table *get_class_table(pa_mir_volume *volume, int class)
+{
+    vlim_table *classlim;
+    size_t      newlen;
+    size_t      size;
+    size_t      diff;
+
+    pa_assert(volume);
+    pa_assert(class > 0);
+
+    if (class < volume->classlen)
+        return volume->classlim + class;
+
+    newlen = (size_t)(class + 1);
+    size = sizeof(vlim_table) * newlen;
+    diff = sizeof(vlim_table) * (newlen - (size_t)volume->classlen);
+
+    pa_assert_se((classlim = realloc(volume->classlim, size)));
+    memset(classlim + volume->classlen, 0, diff);
+
+    volume->classlen = (int)newlen;
+    volume->classlim = classlim;
+
+    return classlim + class;
+}
+
+/*
+ * Native equivalents of running mir_volume_suppress() and
+ * mir_volume_correction() through the scripting bridge. Nodes without
+ * scripting counterpart get the same -90 dB what the bridge would give.
+ */
+static double apply_suppressions(double         attenuation,
+                                 pa_mir_volume *volume,
+                                 int            class,
+                                 mir_node      *node,
+                                 uint32_t       mask)
+{
+    vlim_suppress *e, *end;
+    uint32_t       clmask;
+    double         a;
+
+    clmask = mir_volume_get_class_mask(class);
+    e      = volume->builtin.suppress;
+    end    = e + volume->builtin.nsuppress;
+
+    for (;  e < end;  e++) {
+        if (!(e->classes & clmask))
+            continue;
+
+        if (!node || !node->scripting)
+            a = -90.0;
+        else if (!(e->trigger & clmask) && (e->trigger & mask))
+            a = *e->attenuation;
+        else
+            continue;
+
+        if (a < attenuation)
+            attenuation = a;
+    }
+
+    return attenuation;
+}
+
+static double apply_corrections(double         attenuation,
+                                pa_mir_volume *volume,
+                                mir_node      *node)
+{
+    double ***e, ***end;
+    double    a;
+    bool      public;
+
+    e   = volume->builtin.correct;
+    end = e + volume->builtin.ncorrect;
+
+    if (e == end)
+        return attenuation;
+
+    public = node && node->implement == mir_device &&
+             node->privacy == mir_public;
+
+    for (;  e < end;  e++) {
+        if (!node || !node->scripting)
+            a = -90.0;
+        else if (public && **e)
+            a = ***e;
+        else
+            continue;
+
+        if (a < attenuation)
+            attenuation = a;
+    }
+
+    return attenuation;
+}
+
+static vlim_memo *memo_slot(pa_mir_volume *volume,
+                            mir_node      *node,
+                            uint32_t       mask,
+                            int            class)
+{
+    uint32_t h;
+
+    pa_assert(volume);
+
+    if (!node || node->index == PA_IDXSET_INVALID)
+        return NULL;
+
+    h = node->index * 2654435761U;
+    h ^= mask * 40503U;
+    h ^= (uint32_t)class * 97U;
+    h ^= h >> 16;
+
+    return volume->memo.entries + (h & (VLIM_MEMO_SIZE - 1));
+}
+
 static void add_to_table(vlim_table *tbl, mir_volume_func_t func, void *arg)
 {
     size_t      size;
@@ -424,7 +653,7 @@ static void reset_volume_limit(struct userdata *u,
 
     if ((sink = pa_idxset_get_by_index(core->sinks, node->paidx))) {
         PA_IDXSET_FOREACH(sinp, sink->inputs, i) {
-            class = pa_utils_get_stream_class(sinp->proplist);
+            class = pa_discover_get_stream_meta(u, sinp)->class;
             add_volume_limit(u, node, class);
         }
     }
@@ -36,6 +36,8 @@ struct mir_vlim {
     int           *classes;     /**< class table  */
     uint32_t       clmask;      /**< bits of the classes */
     uint32_t       stamp;
+    uint32_t       actmask;     /**< active classes at the last fading */
+    bool           applied;     /**< limits were applied with actmask */
 };
 
 struct mir_volume_suppress_arg {
@@ -54,8 +56,12 @@ void pa_mir_volume_done(struct userdata *);
 void mir_volume_add_class_limit(struct userdata *,int,mir_volume_func_t,void*);
 void mir_volume_add_generic_limit(struct userdata *, mir_volume_func_t,void *);
 void mir_volume_add_maximum_limit(struct userdata *, double, size_t, int *);
+void mir_volume_add_suppress_limit(struct userdata *, size_t, int *,
+                                   mir_volume_suppress_arg *);
+void mir_volume_add_correction_limit(struct userdata *, double **);
 
 void mir_volume_make_limiting(struct userdata *);
+void mir_volume_invalidate_limits(struct userdata *);
 
 void mir_volume_add_limiting_class(struct userdata *,mir_node *,int,uint32_t);
 double mir_volume_apply_limits(struct userdata *, mir_node *,uint32_t, int,uint32_t);
@@ -123,6 +123,16 @@ mir_zone *pa_zoneset_get_zone_by_index(struct userdata *u, uint32_t index)
     return zone;
 }
 
+uint32_t pa_zoneset_get_zone_index(struct userdata *u, const char *name)
+{
+    mir_zone *zone;
+
+    if ((zone = pa_zoneset_get_zone_by_name(u, name)))
+        return zone->index;
+
+    return PA_IDXSET_INVALID;
+}
+
 void pa_zoneset_update_module_property(struct userdata *u)
 {
     pa_module *module;
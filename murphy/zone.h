@@ -35,6 +35,7 @@ void pa_zoneset_done(struct userdata *);
 int pa_zoneset_add_zone(struct userdata *, const char *, uint32_t);
 mir_zone *pa_zoneset_get_zone_by_name(struct userdata *, const char *);
 mir_zone *pa_zoneset_get_zone_by_index(struct userdata *, uint32_t);
+uint32_t pa_zoneset_get_zone_index(struct userdata *, const char *);
 
 void pa_zoneset_update_module_property(struct userdata *);
 